@@ -0,0 +1,36 @@
+/*
+ * NEC-only IR decoder, enabled by building with -D IR_EDGE_DECODER (see platformio.ini).
+ *
+ * Instead of sampling the receiver output with the 10-15 kHz IRMP interrupt, every edge on PB2
+ * raises a pin change interrupt and the time between two falling edges (start of a mark) is
+ * measured with Timer0 at CK/1024. That is ~70 interrupts per NEC frame and none while the
+ * remote is idle. A frame is a 13.5 ms leader and 32 bits (1.125 ms = 0, 2.25 ms = 1) holding
+ * address, inverted address, command and inverted command; a held key sends 11.25 ms repeat
+ * frames every 108 ms.
+ *
+ * The decoder implements the part of the IRMP interface the controller uses, so the rest of the
+ * firmware doesn't care which decoder is built in. The PCINT0 interrupt belongs to the caller,
+ * which has to pass every pin change on to necEdge().
+ */
+
+#ifndef NECDECODER_H
+#define NECDECODER_H
+
+#include <stdint.h>
+
+#define IRMP_NEC_PROTOCOL 2
+#define IRMP_FLAG_REPETITION 0x01
+
+typedef struct {
+    uint8_t protocol;
+    uint16_t address;       // 8 bit, or 16 bit for extended NEC without inverted address
+    uint16_t command;
+    uint8_t flags;
+} IRMP_DATA;
+
+void irmp_init();
+bool irmp_get_data(IRMP_DATA *data);
+void irmp_register_complete_callback_function(void (*callback)(void));
+void necEdge();
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Profiling of the hot paths, enabled by building with -D PROFILE (see platformio.ini).
+ *
+ * Every instrumented section toggles a spare pin while it runs, PB0 for main loop code and PB3
+ * for interrupt code, so a logic analyzer shows each call as a pulse. The duration is also taken
+ * from Timer1 (overflow count and TCNT1) and the worst case per section is kept in profileStats,
+ * which is saved to the top of the EEPROM with the settings (read it with avrdude -U eeprom:r).
+ * Durations are in Timer1 clocks, 1 / PWM_CLOCK each: 2 us with the default CK/16, 1 / (64 MHz /
+ * PWM_PLL_PRESCALER) with the PLL, e.g. 0.25 us at 16; they saturate at 0xFFFF. Without PROFILE all
+ * of this compiles to nothing.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+// instrumented sections and their worst case slot in profileStats
+enum ProfileSection : uint8_t {
+    PROFILE_COMMAND,        // processKey()
+    PROFILE_BRIGHTNESS,     // setBrightness()
+    PROFILE_IR,             // IRMP complete callback, runs in the Timer0 interrupt
+    PROFILE_TIMER1,         // Timer1 overflow interrupt: dither, millisecond tick and fade
+    PROFILE_SECTIONS
+};
+
+#ifdef PROFILE
+
+#include <avr/io.h>
+
+const int EEPROM_PROFILE_ADDR = 512 - PROFILE_SECTIONS * 2;  // last bytes of the EEPROM
+
+struct ProfileStats {
+    uint16_t worst[PROFILE_SECTIONS];
+};
+
+extern struct ProfileStats profileStats;
+extern volatile uint32_t profileOverflows;  // Timer1 overflows, counted by the Timer1 ISR
+
+void setupProfile();
+uint32_t profileTime();
+
+// called first thing in the Timer1 overflow ISR
+inline void profileOverflow() {
+    profileOverflows++;
+}
+
+// measures the lifetime of the object as a section, the pin toggles on entry and on exit
+class ProfileScope {
+public:
+    explicit ProfileScope(uint8_t section) : section(section), start(profileTime()) {
+        PINB = pin();   // writing a one to PINB toggles the pin
+    }
+    ~ProfileScope() {
+        uint32_t duration = profileTime() - start;
+        PINB = pin();
+        uint16_t ticks = duration > 0xFFFF ? 0xFFFF : uint16_t(duration);
+        if (ticks > profileStats.worst[section]) profileStats.worst[section] = ticks;
+    }
+
+private:
+    uint8_t pin() const {
+        return section < PROFILE_IR ? (1 << PB0) : (1 << PB3);
+    }
+    uint8_t section;
+    uint32_t start;
+};
+
+#define PROFILE_SCOPE(section) ProfileScope profileScope(section)
+
+#else
+
+inline void setupProfile() {}
+inline void profileOverflow() {}
+
+#define PROFILE_SCOPE(section)
+
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Controller state: everything the lamp keeps between IR commands, packed into three bytes.
+ *
+ * The same image is stored in the settings log in EEPROM and read back by the host simulation.
+ * packState() and unpackState() are the only conversion between the live state and a stored
+ * image, so both agree on the format. The reset marker in .noinit RAM holds no state, only the
+ * tap count of the multi-tap gesture with a CRC8: the settings come from the log after every reset.
+ */
+
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdint.h>
+
+// logical color, the PWM values are derived from it only when they are written to the timer
+struct ColorState {
+    uint8_t brightness;     // level of the dominant string (0-255)
+    uint8_t mix;            // color temperature: 0 = cold only, 128 = both strings full, 255 = warm only
+};
+
+struct ControllerState {
+    struct ColorState color;
+    uint8_t preset : 3;     // active color temperature preset
+    uint8_t night : 1;      // nightlight active
+    uint8_t off : 1;        // switched off by remote, not stored
+    uint8_t timerStep : 3;  // lights-off timer: 0 = off, 1..4 = lightOffMinutes[timerStep - 1], not stored
+};
+
+static_assert(sizeof(struct ControllerState) == 3, "state has to fit the settings log record");
+
+// power-on count of a multi-tap gesture that survives a short power cut in .noinit RAM
+struct ResetMarker {
+    uint8_t taps;
+    uint8_t check;          // CRC8 over the bytes above, seeded so that cleared RAM doesn't pass
+};
+
+extern struct ControllerState state;
+
+uint8_t crc8(uint8_t crc, const void *data, uint8_t size);
+struct ControllerState packState();
+void unpackState(struct ControllerState image);
+bool stateEqual(struct ControllerState a, struct ControllerState b);
+void markTaps(volatile struct ResetMarker *marker, uint8_t taps);
+bool markerValid(const volatile struct ResetMarker *marker);
+void clearMarker(volatile struct ResetMarker *marker);
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Timebase: seconds from the watchdog timer and a millisecond tick derived from the Timer1 overflow.
+ *
+ * Both counters are written by interrupts; read them only through seconds() and msTicks(), which
+ * copy the multi-byte values with interrupts blocked so a read can never be torn by an increment.
+ * The deadline helpers work with the wrapping difference, so they stay correct across overflows.
+ *
+ * The watchdog oscillator drifts by +-10% with supply voltage and temperature. Every WDT period
+ * that Timer1 runs through is measured in system clock milliseconds, and the seconds counter
+ * advances by the measured (filtered) period instead of assuming one second per interrupt.
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+
+extern volatile uint32_t timeCounter;   // seconds, WDT interrupt
+extern volatile uint16_t msCounter;     // milliseconds, Timer1 overflow interrupt
+extern uint16_t msFraction;             // overflow remainder for the millisecond tick, ISR only
+
+void setupWDT();
+void suspendCalibration();
+uint32_t seconds();
+uint16_t msTicks();
+
+// true once `duration` seconds have passed since `start` (a value returned by seconds())
+inline bool secondsPassed(uint32_t start, uint32_t duration) {
+    return seconds() - start >= duration;
+}
+
+// true once `duration` milliseconds have passed since `start` (a value returned by msTicks()), up to 65 s
+inline bool msPassed(uint16_t start, uint16_t duration) {
+    return uint16_t(msTicks() - start) >= duration;
+}
+
+// called from the Timer1 overflow ISR, returns true when a millisecond has passed:
+// 1000 ms per overflowHz overflows, without accumulating a rounding error
+inline bool timebaseTick(uint16_t overflowHz) {
+    msFraction += 1000;
+    if (msFraction < overflowHz) return false;
+    msFraction -= overflowHz;
+    msCounter++;
+    return true;
+}
+
+#endif
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+LED calibration block of the EEPROM, bytes 486-492 (see loadCalibration() in src/main.cpp).
+
+Prints the avrdude command that writes just these seven bytes, so the settings log and the
+presets stay as they are:
+
+    sim/calibration.py -b 1150 255 230 255 200 192
+    avrdude -c usbasp -p attiny85 -T "write eeprom 486 0xff 0xe6 0xff 0xc8 0xc0 0x32 0x40"
+
+With -i the block is patched into an EEPROM image instead, 512 bytes, created erased if it
+doesn't exist (for `replay -i`, or `avrdude -U eeprom:w:image.bin:r` of a full image).
+
+usage: calibration.py [-i eeprom.bin] [-b mV] gain_cold gain_warm max_cold max_warm budget
+  gain_cold, gain_warm  duty cycle scale of each string, 255 = 1.0
+  max_cold, max_warm    duty cycle limit of each string after the gain, 255 = none
+  budget                combined power cap: cold + warm <= 2 * budget, 255 = no cap
+  -b mV                 measured bandgap voltage of the part (973-1227), default 1100; it sets
+                        the supply thresholds of the power fail save
+"""
+
+import argparse
+import os
+import sys
+
+CALIBRATION_ADDR = 486
+CALIBRATION_SEED = 0xC3     # CALIBRATION_SEED in src/main.cpp
+EEPROM_SIZE = 512
+
+
+def crc8(data, crc):
+    # _crc8_ccitt_update() of avr-libc, polynomial 0x07
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def byte(text):
+    value = int(text, 0)
+    if not 0 <= value <= 255:
+        raise argparse.ArgumentTypeError("%s is not a byte" % text)
+    return value
+
+
+def main():
+    parser = argparse.ArgumentParser(description="LED calibration block of the EEPROM")
+    parser.add_argument("-i", "--image", help="patch this EEPROM image instead of printing the avrdude command")
+    parser.add_argument("-b", "--bandgap", type=int, default=1100, help="measured bandgap voltage in mV")
+    for name in ("gain_cold", "gain_warm", "max_cold", "max_warm", "budget"):
+        parser.add_argument(name, type=byte)
+    args = parser.parse_args()
+
+    trim = args.bandgap - 1100
+    if not -127 <= trim <= 127:
+        parser.error("bandgap %d mV out of range" % args.bandgap)
+    block = bytes([args.gain_cold, args.gain_warm, args.max_cold, args.max_warm, args.budget, trim & 0xFF])
+    block += bytes([crc8(block, CALIBRATION_SEED)])
+
+    if not args.image:
+        print('avrdude -c usbasp -p attiny85 -T "write eeprom %d %s"'
+              % (CALIBRATION_ADDR, " ".join("0x%02x" % b for b in block)))
+        return 0
+
+    image = bytearray(b"\xff" * EEPROM_SIZE)
+    if os.path.exists(args.image):
+        with open(args.image, "rb") as file:
+            image = bytearray(file.read())
+        if len(image) != EEPROM_SIZE:
+            sys.exit("%s: expected %d bytes" % (args.image, EEPROM_SIZE))
+    image[CALIBRATION_ADDR:CALIBRATION_ADDR + len(block)] = block
+    with open(args.image, "wb") as file:
+        file.write(image)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,22 @@
+/*
+ * Simulator shim: Arduino EEPROM library on top of the simulated EEPROM array.
+ */
+
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include <stdint.h>
+
+uint8_t *simEeprom();
+void simEepromProgrammed();
+
+struct EEPROMClass {
+    uint8_t read(int idx) { return simEeprom()[idx & 511]; }
+    void write(int idx, uint8_t val) { simEeprom()[idx & 511] = val; simEepromProgrammed(); }
+    void update(int idx, uint8_t val) { if (read(idx) != val) write(idx, val); }
+    uint16_t length() { return 512; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
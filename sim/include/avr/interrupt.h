@@ -0,0 +1,14 @@
+/*
+ * Simulator shim: the simulator runs interrupt handlers only between main loop steps and while
+ * the firmware sleeps, so enabling or disabling interrupts has nothing to do.
+ */
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+inline void cli() {}
+inline void sei() {}
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Simulator shim: ATtiny85 I/O registers for the host build.
+ *
+ * Every register is a SimRegister, which behaves like the uint8_t the firmware expects. Registers
+ * with side effects (EEPROM control, PLL) carry a write hook that the simulator installs, all
+ * others are plain storage that the simulator samples (OCR1A/OCR1B, TCCR1, TIMSK, ...).
+ */
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+template <typename T>
+class SimRegister {
+public:
+    typedef void (*Hook)(SimRegister<T> &reg, T oldValue);
+
+    T value;
+    Hook onWrite;
+
+    operator T() const { return value; }
+    SimRegister &operator=(const SimRegister &other) { return *this = other.value; }
+    SimRegister &operator=(unsigned int v) {
+        T old = value;
+        value = T(v);
+        if (onWrite) onWrite(*this, old);
+        return *this;
+    }
+    SimRegister &operator|=(unsigned int v) { return *this = value | v; }
+    SimRegister &operator&=(unsigned int v) { return *this = value & v; }
+    SimRegister &operator^=(unsigned int v) { return *this = value ^ v; }
+};
+
+typedef SimRegister<uint8_t> SimRegister8;
+typedef SimRegister<uint16_t> SimRegister16;
+
+extern SimRegister8 PINB, DDRB, PORTB;
+extern SimRegister8 EECR, EEDR;
+extern SimRegister16 EEAR;
+extern SimRegister8 PCMSK, GIMSK, GIFR, MCUCR, MCUSR, PRR;
+extern SimRegister8 WDTCR, OSCCAL, PLLCSR;
+extern SimRegister8 TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B;
+extern SimRegister8 TCCR1, GTCCR, TCNT1, OCR1A, OCR1B, OCR1C, TIMSK, TIFR;
+extern SimRegister8 ADMUX, ADCSRA, ADCSRB, ADCL, ADCH, DIDR0, ACSR;
+extern SimRegister16 ADC;
+
+#define _BV(bit) (1 << (bit))
+
+// PORTB
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+
+// EECR
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+#define EEPM0 4
+#define EEPM1 5
+
+// PCMSK, GIMSK, GIFR
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+#define PCINT4 4
+#define PCINT5 5
+#define PCIE 5
+#define INT0 6
+#define PCIF 5
+#define INTF0 6
+
+// MCUCR, MCUSR, PRR
+#define ISC00 0
+#define ISC01 1
+#define BODSE 2
+#define SM0 3
+#define SM1 4
+#define SE 5
+#define PUD 6
+#define BODS 7
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define PRADC 0
+#define PRUSI 1
+#define PRTIM0 2
+#define PRTIM1 3
+
+// WDTCR
+#define WDP0 0
+#define WDP1 1
+#define WDP2 2
+#define WDE 3
+#define WDCE 4
+#define WDP3 5
+#define WDIE 6
+#define WDIF 7
+
+// PLLCSR
+#define PLOCK 0
+#define PLLE 1
+#define PCKE 2
+#define LSM 7
+
+// TCCR0A, TCCR0B
+#define WGM00 0
+#define WGM01 1
+#define COM0B0 4
+#define COM0B1 5
+#define COM0A0 6
+#define COM0A1 7
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM02 3
+
+// TCCR1, GTCCR
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define CS13 3
+#define COM1A0 4
+#define COM1A1 5
+#define PWM1A 6
+#define CTC1 7
+#define PSR0 0
+#define PSR1 1
+#define FOC1A 2
+#define FOC1B 3
+#define COM1B0 4
+#define COM1B1 5
+#define PWM1B 6
+#define TSM 7
+
+// TIMSK, TIFR
+#define TOIE0 1
+#define TOIE1 2
+#define OCIE0B 3
+#define OCIE0A 4
+#define OCIE1B 5
+#define OCIE1A 6
+#define TOV0 1
+#define TOV1 2
+#define OCF0B 3
+#define OCF0A 4
+#define OCF1B 5
+#define OCF1A 6
+
+// ADMUX, ADCSRA, ADCSRB
+#define MUX0 0
+#define MUX1 1
+#define MUX2 2
+#define MUX3 3
+#define REFS2 4
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+#define ADTS0 0
+#define ADTS1 1
+#define ADTS2 2
+
+#define E2END 511
+#define RAMEND 0x25F
+
+// interrupt handlers become plain functions, called by the simulator
+#define ISR(vector, ...) extern "C" void vector(void)
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Simulator shim: sleeping hands control to the simulator, which advances the simulated time
+ * to the next event that wakes up the selected sleep mode.
+ */
+
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC 1
+#define SLEEP_MODE_PWR_DOWN 2
+
+void simSleep(uint8_t mode);
+extern uint8_t simSleepMode;
+
+inline void set_sleep_mode(uint8_t mode) { simSleepMode = mode; }
+inline void sleep_enable() {}
+inline void sleep_disable() {}
+inline void sleep_bod_disable() {}
+inline void sleep_cpu() { simSleep(simSleepMode); }
+inline void sleep_mode() { simSleep(simSleepMode); }
+
+#endif
@@ -0,0 +1,12 @@
+/*
+ * Simulator shim: the watchdog is configured through WDTCR, see avr/io.h.
+ */
+
+#ifndef SIM_AVR_WDT_H
+#define SIM_AVR_WDT_H
+
+#include <avr/io.h>
+
+inline void wdt_reset() {}
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Simulator shim: IRMP interface as used by the firmware. The simulator delivers NEC frames
+ * through the registered completion callback, like the IRMP Timer0 interrupt does.
+ */
+
+#ifndef SIM_IRMP_HPP
+#define SIM_IRMP_HPP
+
+#include <stdint.h>
+
+#define IRMP_NEC_PROTOCOL 2
+#define IRMP_ONKYO_PROTOCOL 56
+#define IRMP_FLAG_REPETITION 0x01
+#define IRMP_FLAG_RELEASE 0x02
+
+typedef struct {
+    uint8_t protocol;
+    uint16_t address;
+    uint16_t command;
+    uint8_t flags;
+} IRMP_DATA;
+
+void irmp_init();
+bool irmp_get_data(IRMP_DATA *data);
+void irmp_register_complete_callback_function(void (*callback)(void));
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * Simulator shim: interrupt handlers never preempt the main loop in the simulator.
+ */
+
+#ifndef SIM_UTIL_ATOMIC_H
+#define SIM_UTIL_ATOMIC_H
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 0
+#define NONATOMIC_RESTORESTATE 0
+#define NONATOMIC_FORCEOFF 0
+
+#define ATOMIC_BLOCK(type) for (bool simAtomic = true; simAtomic; simAtomic = false)
+#define NONATOMIC_BLOCK(type) for (bool simAtomic = true; simAtomic; simAtomic = false)
+
+#endif
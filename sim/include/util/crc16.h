@@ -0,0 +1,18 @@
+/*
+ * Simulator shim: same algorithms as avr-libc <util/crc16.h>.
+ */
+
+#ifndef SIM_UTIL_CRC16_H
+#define SIM_UTIL_CRC16_H
+
+#include <stdint.h>
+
+inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data) {
+    uint8_t value = crc ^ data;
+    for (uint8_t i = 0; i < 8; i++) {
+        value = (value & 0x80) ? uint8_t((value << 1) ^ 0x07) : uint8_t(value << 1);
+    }
+    return value;
+}
+
+#endif
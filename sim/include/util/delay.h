@@ -0,0 +1,11 @@
+/*
+ * Simulator shim: busy waits take no simulated time.
+ */
+
+#ifndef SIM_UTIL_DELAY_H
+#define SIM_UTIL_DELAY_H
+
+inline void _delay_us(double) {}
+inline void _delay_ms(double) {}
+
+#endif
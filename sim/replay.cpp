@@ -0,0 +1,174 @@
+/*
+ * Replay an IR command script through the host simulation and report the PWM output timeline
+ * and the work done per command.
+ *
+ * usage: replay [-t] [-w scale] [-b mV] [-i eeprom.bin] [-e eeprom.bin] script.ir
+ *   -t             print the PWM timeline (mean duty cycles, 0..255)
+ *   -w scale       WDT period relative to nominal, e.g. 1.1 for a 10% slow oscillator
+ *   -b mV          bandgap voltage of the part, default 1100
+ *   -i file        EEPROM image to start with (512 bytes), default erased
+ *   -e file        write the EEPROM image at the end
+ *
+ * Script lines are `<time_ms> <key> [hold_ms]`, `<time_ms> vcc <mV> [ramp_ms]` (supply voltage)
+ * or `<time_ms> end`, `#` starts a comment. Keys are the names from doc/ir-codes or decimal NEC
+ * commands. Without `end` the replay stops 5 s after the last key.
+ */
+
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "simulator.h"
+#include "state.h"
+
+struct KeyName {
+    const char *name;
+    uint8_t command;
+};
+
+// NEC commands of the Lidl remote, see doc/ir-codes
+const KeyName keyNames[] = {
+    { "on/off", 69 }, { "lamp", 71 }, { "warm", 64 }, { "cold", 25 },
+    { "low", 7 }, { "high", 9 }, { "10%", 12 }, { "50%", 24 }, { "100%", 94 },
+    { "night", 8 }, { "d1", 28 }, { "30min", 90 },
+};
+
+static const char *keyName(uint8_t command) {
+    static char number[4];
+    if (command == 0xFF) return "boot";
+    for (size_t i = 0; i < sizeof(keyNames) / sizeof(keyNames[0]); i++) {
+        if (keyNames[i].command == command) return keyNames[i].name;
+    }
+    snprintf(number, sizeof(number), "%u", command);
+    return number;
+}
+
+static bool parseKey(const char *text, uint8_t *command) {
+    for (size_t i = 0; i < sizeof(keyNames) / sizeof(keyNames[0]); i++) {
+        if (!strcasecmp(keyNames[i].name, text)) {
+            *command = keyNames[i].command;
+            return true;
+        }
+    }
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (*end || end == text || value > 255) return false;
+    *command = uint8_t(value);
+    return true;
+}
+
+// schedules the keys of the script, returns the end of the replay in ms
+static uint32_t loadScript(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    char line[128];
+    unsigned lineNumber = 0;
+    uint32_t last = 0;
+    uint32_t end = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = 0;
+        unsigned timeMs, holdMs = 0, rampMs = 0;
+        char key[16];
+        int fields = sscanf(line, "%u %15s %u %u", &timeMs, key, &holdMs, &rampMs);
+        if (fields <= 0) continue;
+        uint8_t command;
+        if (fields >= 2 && !strcasecmp(key, "end")) {
+            end = timeMs;
+        } else if (fields >= 3 && !strcasecmp(key, "vcc") && timeMs >= last) {
+            simVcc(timeMs, holdMs, rampMs);
+            last = timeMs + rampMs;
+        } else if (fields >= 2 && parseKey(key, &command) && timeMs >= last) {
+            simKey(timeMs, command, holdMs);
+            last = timeMs;
+        } else {
+            fprintf(stderr, "%s:%u: expected `<time_ms> <key> [hold_ms]` or `<time_ms> vcc <mV> [ramp_ms]` in time order\n",
+                    path, lineNumber);
+            exit(1);
+        }
+    }
+    fclose(file);
+    return end ? end : last + 5000;
+}
+
+static void readImage(const char *path, uint8_t *image, size_t size) {
+    FILE *file = fopen(path, "rb");
+    if (!file || fread(image, 1, size, file) != size) {
+        fprintf(stderr, "%s: expected a %u byte EEPROM image\n", path, unsigned(size));
+        exit(1);
+    }
+    fclose(file);
+}
+
+static void writeImage(const char *path, const uint8_t *image, size_t size) {
+    FILE *file = fopen(path, "wb");
+    if (!file || fwrite(image, 1, size, file) != size) {
+        perror(path);
+        exit(1);
+    }
+    fclose(file);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: replay [-t] [-w scale] [-b mV] [-i eeprom.bin] [-e eeprom.bin] script.ir\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    bool printTimeline = false;
+    const char *imageIn = 0;
+    const char *imageOut = 0;
+    int option;
+    while ((option = getopt(argc, argv, "tw:b:i:e:")) != -1) {
+        switch (option) {
+            case 't': printTimeline = true; break;
+            case 'w': simConfig.wdtScale = strtof(optarg, 0); break;
+            case 'b': simConfig.bandgapMv = uint16_t(atoi(optarg)); break;
+            case 'i': imageIn = optarg; break;
+            case 'e': imageOut = optarg; break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1) usage();
+
+    uint8_t image[512];
+    if (imageIn) readImage(imageIn, image, sizeof(image));
+    simPowerOn(imageIn ? image : 0);
+    uint32_t end = loadScript(argv[optind]);
+    simRun(end);
+
+    if (printTimeline) {
+        printf("# time_ms   cold   warm\n");
+        for (size_t i = 0; i < simTimeline().size(); i++) {
+            const SimSample &sample = simTimeline()[i];
+            printf("%9u %6.2f %6.2f\n", sample.timeMs, sample.cold, sample.warm);
+        }
+        printf("\n");
+    }
+
+    printf("# time_ms  key     frames lost response_ms settle_ms  loops   isr eeprom  host_us\n");
+    for (size_t i = 0; i < simCommands().size(); i++) {
+        const SimCommand &command = simCommands()[i];
+        printf("%9u  %-7s %6u %4u %11d %9d %6u %5u %6u %8.1f\n",
+               command.timeMs, keyName(command.command), command.frames, command.lost,
+               command.responseMs, command.settleMs, command.loops, command.isrCalls,
+               command.eepromWrites, command.hostNs / 1000.0);
+    }
+    printf("# %u ms simulated, %u EEPROM byte writes, %u IR frames lost\n",
+           simMillis(), simEepromWrites(), simFramesLost());
+    if (simPowerLost()) printf("# power lost at %u ms\n", simPowerLost());
+    printf("# state: brightness %u, mix %u, preset %u, night %u, off %u, timer %u\n",
+           state.color.brightness, state.color.mix, state.preset, state.night, state.off, state.timerStep);
+
+    if (imageOut) writeImage(imageOut, simEeprom(), 512);
+    return 0;
+}
+
+#endif
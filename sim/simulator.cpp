@@ -0,0 +1,639 @@
+/*
+ * Host simulation of the LED Lighting Controller, see simulator.h.
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#ifdef IR_EDGE_DECODER
+#include "necdecoder.h"
+#else
+#include <irmp.hpp>
+#endif
+#include <avr/sleep.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "simulator.h"
+
+// interrupt vectors of the firmware, a missing handler is never called
+extern "C" {
+void TIMER1_OVF_vect(void) __attribute__((weak));
+void WDT_vect(void) __attribute__((weak));
+void EE_RDY_vect(void) __attribute__((weak));
+void PCINT0_vect(void) __attribute__((weak));
+void ADC_vect(void) __attribute__((weak));
+void TIMER0_COMPA_vect(void) __attribute__((weak));
+}
+
+SimRegister8 PINB, DDRB, PORTB;
+SimRegister8 EECR, EEDR;
+SimRegister16 EEAR;
+SimRegister8 PCMSK, GIMSK, GIFR, MCUCR, MCUSR, PRR;
+SimRegister8 WDTCR, OSCCAL, PLLCSR;
+SimRegister8 TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B;
+SimRegister8 TCCR1, GTCCR, TCNT1, OCR1A, OCR1B, OCR1C, TIMSK, TIFR;
+SimRegister8 ADMUX, ADCSRA, ADCSRB, ADCL, ADCH, DIDR0, ACSR;
+SimRegister16 ADC;
+
+EEPROMClass EEPROM;
+uint8_t simSleepMode = SLEEP_MODE_IDLE;
+SimConfig simConfig = { 1.0f, 4096, 1100 };
+
+typedef std::chrono::steady_clock HostClock;
+
+const uint64_t NS_PER_MS = 1000000ULL;
+const uint64_t STEP_NS = 512000ULL;             // main loop period while Timer1 is stopped
+const uint64_t EEPROM_PROGRAM_NS = 3400000ULL;  // erase and write of one byte
+const uint64_t NEC_FRAME_NS = 67500000ULL;      // leader, address, command and stop bit
+const uint64_t NEC_REPEAT_NS = 11800000ULL;     // repeat frame
+const uint64_t NEC_PERIOD_NS = 108000000ULL;    // repeat frames follow every 108 ms
+const uint64_t IR_LEADER_NS = 1000000ULL;       // IRMP has to run from early in the leader on
+const uint64_t NEC_LEADER_MARK_NS = 9000000ULL;
+const uint64_t NEC_LEADER_NS = 13500000ULL;     // falling edge to falling edge: leader mark and space
+const uint64_t NEC_REPEAT_LEADER_NS = 11250000ULL;
+const uint64_t NEC_BIT_MARK_NS = 560000ULL;
+const uint64_t NEC_ZERO_NS = 1125000ULL;
+const uint64_t NEC_ONE_NS = 2250000ULL;
+const uint64_t TIMER0_TICK_NS = 1024ULL * 1000000000ULL / F_CPU;   // CK/1024
+const uint64_t NEVER = ~0ULL;
+const uint8_t SIM_BOOT = 0xFF;                  // command entry for setup() and everything before the first key
+const uint16_t VCC_NOMINAL_MV = 5000;
+const uint16_t VCC_MIN_MV = 2700;               // the CPU stops below this supply voltage
+const uint64_t OVERRUN_NS = 60000000000ULL;     // firmware kept away from the main loop after the end of a run
+
+// a NEC frame on the IR input
+struct SimFrame {
+    uint64_t startNs;
+    uint64_t endNs;
+    uint8_t command;
+    bool repeat;
+    size_t commandIndex;
+};
+
+static uint64_t nowNs;
+static uint64_t nextWdtNs = NEVER;
+static uint64_t powerDownEndNs;
+static bool loopSlept;                   // the main loop called sleep_mode() in this iteration
+static uint8_t eeprom[E2END + 1];
+static uint64_t eepromDoneNs = NEVER;
+static uint16_t eepromAddr;
+static uint8_t eepromData;
+static uint32_t eepromWrites;
+static uint32_t framesLost;
+
+static std::vector<SimFrame> frames;
+static size_t nextFrame;
+static std::vector<SimCommand> commands;
+static size_t nextCommand;
+static size_t currentCommand;
+
+// supply voltage, piecewise linear
+struct SimVccPoint {
+    uint64_t timeNs;
+    uint16_t mV;
+};
+
+// thrown when the simulation can't go on: power lost or stuck in the firmware
+struct SimStop {};
+
+static std::vector<SimVccPoint> vccPoints;
+static uint64_t runUntilNs = NEVER;
+static uint32_t powerLostMs;
+
+static std::vector<SimSample> timeline;
+static uint64_t windowStartNs;
+static uint64_t windowCold, windowWarm;
+static uint32_t windowCount;
+
+#ifdef IR_EDGE_DECODER
+// a level change of the IR receiver output on PB2, active low
+struct SimEdge {
+    uint64_t timeNs;
+    bool high;
+    bool frameEnd;          // falling edge of the stop bit: the frame is complete
+    size_t commandIndex;
+};
+
+static std::vector<SimEdge> edges;
+static size_t nextEdge;
+static bool timer0Running;
+static uint64_t timer0PausedNs;         // Timer0 stands still in power-down
+static uint64_t timer0Wraps;
+static void (*necFirmwareCallback)(void);
+static uint32_t necDecoded;             // frames the decoder passed on to the firmware
+static uint32_t necDecodedBefore;
+extern void (*necCallback)(void);       // src/necdecoder.cpp
+#else
+static void (*irmpCallback)(void);
+static IRMP_DATA irmpData;
+static bool irmpAvailable;
+#endif
+
+static int firmwareDepth;
+static HostClock::time_point firmwareSince;
+
+// host time spent in firmware code, nested calls (an ISR from within an idle wait) count once
+static void enterFirmware() {
+    if (firmwareDepth++ == 0) firmwareSince = HostClock::now();
+}
+
+static void leaveFirmware() {
+    if (--firmwareDepth) return;
+    commands[currentCommand].hostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        HostClock::now() - firmwareSince).count();
+}
+
+static void callISR(void (*vector)(void)) {
+    if (!vector) return;
+    commands[currentCommand].isrCalls++;
+    enterFirmware();
+    vector();
+    leaveFirmware();
+}
+
+// registers with side effects
+
+static void writeEECR(SimRegister8 &reg, uint8_t old) {
+    uint8_t value = reg.value;
+    if (value & _BV(EERE)) {
+        EEDR.value = eeprom[EEAR & E2END];
+        value &= ~_BV(EERE);
+    }
+    if (eepromDoneNs != NEVER) {
+        // EEPE stays set until the running write is done
+        value |= _BV(EEPE);
+    } else if (value & _BV(EEPE)) {
+        if (old & _BV(EEMPE)) {
+            eepromAddr = EEAR & E2END;
+            eepromData = EEDR;
+            eepromDoneNs = nowNs + EEPROM_PROGRAM_NS;
+        } else {
+            value &= ~_BV(EEPE);
+        }
+        value &= ~_BV(EEMPE);
+    }
+    reg.value = value;
+}
+
+static void writePINB(SimRegister8 &reg, uint8_t old) {
+    // writing a one toggles the PORTB bit, the pin levels are inputs
+    PORTB.value ^= reg.value;
+    reg.value = old;
+}
+
+static uint64_t wdtPeriodNs() {
+    uint8_t prescaler = (WDTCR & 0x07) | ((WDTCR & _BV(WDP3)) >> 2);
+    return uint64_t(16 * NS_PER_MS * simConfig.wdtScale) << prescaler;
+}
+
+static void writeWDTCR(SimRegister8 &reg, uint8_t old) {
+    if ((reg.value & _BV(WDIE)) && !(old & _BV(WDIE))) {
+        nextWdtNs = nowNs + wdtPeriodNs();
+    }
+}
+
+static void writePLLCSR(SimRegister8 &reg, uint8_t) {
+    // the PLL locks immediately
+    if (reg.value & _BV(PLLE)) {
+        reg.value |= _BV(PLOCK);
+    } else {
+        reg.value &= ~_BV(PLOCK);
+    }
+}
+
+// Timer1 and the PWM outputs
+
+static uint64_t timer1PeriodNs() {
+    uint8_t clockSelect = TCCR1 & 0x0F;
+    if (!clockSelect) return 0;
+    uint64_t clockHz = (PLLCSR & _BV(PCKE)) ? 64000000ULL : uint64_t(F_CPU);
+    return (uint64_t(OCR1C) + 1) * (1ULL << (clockSelect - 1)) * 1000000000ULL / clockHz;
+}
+
+static uint8_t pinLevel(uint8_t pin) {
+    return ((DDRB & PORTB) & _BV(pin)) ? 255 : 0;
+}
+
+static uint8_t outputCold() {
+    if ((TCCR1 & _BV(PWM1A)) && (TCCR1 & _BV(COM1A1)) && timer1PeriodNs()) return OCR1A;
+    return pinLevel(PB1);
+}
+
+static uint8_t outputWarm() {
+    if ((GTCCR & _BV(PWM1B)) && (GTCCR & _BV(COM1B1)) && timer1PeriodNs()) return OCR1B;
+    return pinLevel(PB4);
+}
+
+static void pushSample(uint64_t timeNs, float cold, float warm, bool perPeriod) {
+    bool changed = true;
+    if (!timeline.empty()) {
+        const SimSample &last = timeline.back();
+        changed = fabsf(last.cold - cold) >= 0.01f || fabsf(last.warm - warm) >= 0.01f;
+    }
+    if (!changed && !perPeriod) return;
+    SimSample sample = { uint32_t(timeNs / NS_PER_MS), cold, warm, uint32_t(timeNs / 1000) };
+    timeline.push_back(sample);
+    if (!changed) return;
+
+    SimCommand &command = commands[currentCommand];
+    int32_t since = int32_t(sample.timeMs) - int32_t(command.timeMs);
+    if (since < 0) since = 0;
+    if (command.responseMs < 0) command.responseMs = since;
+    command.settleMs = since;
+}
+
+static void flushWindow() {
+    if (!windowCount) return;
+    bool perPeriod = windowCount == 1 && uint64_t(simConfig.sampleUs) * 1000 <= nowNs - windowStartNs;
+    pushSample(windowStartNs, float(windowCold) / windowCount, float(windowWarm) / windowCount, perPeriod);
+    windowCount = 0;
+}
+
+// one PWM period with the current compare values
+static void samplePWM(uint64_t periodNs) {
+    if (!windowCount) {
+        windowStartNs = nowNs - periodNs;
+        windowCold = windowWarm = 0;
+    }
+    windowCold += outputCold();
+    windowWarm += outputWarm();
+    windowCount++;
+    if (nowNs - windowStartNs >= uint64_t(simConfig.sampleUs) * 1000) flushWindow();
+}
+
+// supply and ADC
+
+static uint16_t vccAt(uint64_t timeNs) {
+    uint16_t mV = VCC_NOMINAL_MV;
+    for (size_t i = 0; i < vccPoints.size(); i++) {
+        const SimVccPoint &point = vccPoints[i];
+        if (point.timeNs > timeNs) {
+            if (!i) break;
+            const SimVccPoint &last = vccPoints[i - 1];
+            return uint16_t(last.mV + (int32_t(point.mV) - last.mV) *
+                            double(timeNs - last.timeNs) / double(point.timeNs - last.timeNs));
+        }
+        mV = point.mV;
+    }
+    return mV;
+}
+
+// free running conversions, one per step is enough for a supply monitor
+static void convertADC() {
+    if (!(ADCSRA & _BV(ADEN)) || !(ADCSRA & _BV(ADATE))) return;
+    uint16_t result = 0;
+    if ((ADMUX & 0x0F) == 0x0C) {
+        // 1.1 V bandgap against Vcc
+        result = uint16_t(std::min(uint32_t(simConfig.bandgapMv) * 1024 / vccAt(nowNs), uint32_t(1023)));
+    }
+    ADC.value = result;
+    if (ADMUX & _BV(ADLAR)) {
+        ADCH.value = result >> 2;
+        ADCL.value = result << 6;
+    } else {
+        ADCH.value = result >> 8;
+        ADCL.value = result;
+    }
+    if (ADCSRA & _BV(ADIE)) callISR(ADC_vect);
+}
+
+// events
+
+#ifdef IR_EDGE_DECODER
+// Timer0 free running at CK/1024 with a compare match at 0, the time base of the edge decoder
+static void runTimer0(uint64_t timeNs) {
+    if ((TCCR0B & 0x07) != (_BV(CS02) | _BV(CS00))) return;
+    uint64_t ticks = (timeNs - timer0PausedNs) / TIMER0_TICK_NS;
+    if (!timer0Running) {
+        timer0Running = true;
+        timer0Wraps = ticks >> 8;
+    }
+    TCNT0.value = uint8_t(ticks);
+    while (timer0Wraps < ticks >> 8) {
+        timer0Wraps++;
+        if (TIMSK & _BV(OCIE0A)) callISR(TIMER0_COMPA_vect);
+    }
+}
+
+static void countDecoded() {
+    necDecoded++;
+    necFirmwareCallback();
+}
+
+static void deliverEdges() {
+    while (nextEdge < edges.size() && edges[nextEdge].timeNs <= nowNs) {
+        const SimEdge &edge = edges[nextEdge++];
+        runTimer0(edge.timeNs);
+        if (edge.high) {
+            PINB.value |= _BV(PB2);
+        } else {
+            PINB.value &= ~_BV(PB2);
+        }
+        if ((GIMSK & _BV(PCIE)) && (PCMSK & _BV(PCINT2))) callISR(PCINT0_vect);
+        if (!edge.frameEnd) continue;
+        SimCommand &command = commands[edge.commandIndex];
+        if (necDecoded != necDecodedBefore) {
+            command.frames++;
+        } else {
+            command.lost++;
+            framesLost++;
+        }
+        necDecodedBefore = necDecoded;
+        nextFrame++;
+    }
+    runTimer0(nowNs);
+}
+
+static void pushEdge(uint64_t timeNs, bool high, size_t commandIndex, bool frameEnd = false) {
+    SimEdge edge = { timeNs, high, frameEnd, commandIndex };
+    edges.push_back(edge);
+}
+
+// the receiver output of a frame: leader, 32 bits LSB first (address, inverted address,
+// command, inverted command) and the stop bit, or leader and stop bit of a repeat
+static void addEdges(const SimFrame &frame) {
+    uint64_t t = frame.startNs;
+    pushEdge(t, false, frame.commandIndex);
+    pushEdge(t + NEC_LEADER_MARK_NS, true, frame.commandIndex);
+    if (frame.repeat) {
+        t += NEC_REPEAT_LEADER_NS;
+    } else {
+        t += NEC_LEADER_NS;
+        uint32_t bits = 0xFF00UL | (uint32_t(frame.command) << 16) | (uint32_t(uint8_t(~frame.command)) << 24);
+        for (uint8_t i = 0; i < 32; i++, bits >>= 1) {
+            pushEdge(t, false, frame.commandIndex);
+            pushEdge(t + NEC_BIT_MARK_NS, true, frame.commandIndex);
+            t += (bits & 1) ? NEC_ONE_NS : NEC_ZERO_NS;
+        }
+    }
+    pushEdge(t, false, frame.commandIndex, true);
+    pushEdge(t + NEC_BIT_MARK_NS, true, frame.commandIndex);
+}
+#else
+static void deliverFrame(const SimFrame &frame) {
+    SimCommand &command = commands[frame.commandIndex];
+    // the leader wakes the CPU from power-down, IRMP needs to see it from the start
+    if (powerDownEndNs > frame.startNs + IR_LEADER_NS) {
+        command.lost++;
+        framesLost++;
+        return;
+    }
+    command.frames++;
+    irmpData.protocol = IRMP_NEC_PROTOCOL;
+    irmpData.address = 0x00;
+    irmpData.command = frame.command;
+    irmpData.flags = frame.repeat ? IRMP_FLAG_REPETITION : 0;
+    irmpAvailable = true;
+    callISR(irmpCallback);
+}
+#endif
+
+static void serviceEvents() {
+    if (vccAt(nowNs) < VCC_MIN_MV) {
+        powerLostMs = simMillis();
+        throw SimStop();
+    }
+    if (runUntilNs != NEVER && nowNs > runUntilNs + OVERRUN_NS) {
+        fprintf(stderr, "sim: firmware didn't return to the main loop after %u ms\n", simMillis());
+        throw SimStop();
+    }
+    while (nextCommand < commands.size() && commands[nextCommand].timeMs * NS_PER_MS <= nowNs) {
+        currentCommand = nextCommand++;
+    }
+    while (nextWdtNs <= nowNs) {
+        nextWdtNs += wdtPeriodNs();
+        if (WDTCR & _BV(WDIE)) callISR(WDT_vect);
+    }
+    if (eepromDoneNs <= nowNs) {
+        eeprom[eepromAddr] = eepromData;
+        eepromDoneNs = NEVER;
+        EECR.value &= ~_BV(EEPE);
+        simEepromProgrammed();
+    }
+    // EE_RDY is level triggered
+    for (uint8_t i = 0; i < 16 && (EECR & _BV(EERIE)) && !(EECR & _BV(EEPE)); i++) {
+        callISR(EE_RDY_vect);
+    }
+#ifdef IR_EDGE_DECODER
+    deliverEdges();
+#else
+    while (nextFrame < frames.size() && frames[nextFrame].endNs <= nowNs) {
+        deliverFrame(frames[nextFrame++]);
+    }
+#endif
+    convertADC();
+}
+
+// one Timer1 period, or the main loop period while Timer1 is stopped
+static void simAdvance() {
+    uint64_t period = timer1PeriodNs();
+    nowNs += period ? period : STEP_NS;
+    serviceEvents();
+    if (!period) return;
+    samplePWM(period);
+    if (TIMSK & _BV(TOIE1)) callISR(TIMER1_OVF_vect);
+}
+
+static void powerDown() {
+    // Timer1 is stopped, the outputs are static until the next wake up
+    flushWindow();
+    pushSample(nowNs, outputCold(), outputWarm(), false);
+
+    uint64_t wakeNs = (WDTCR & _BV(WDIE)) ? nextWdtNs : NEVER;
+    bool pinChange = (GIMSK & _BV(PCIE)) && (PCMSK & _BV(PCINT2));
+    const SimFrame *frame = 0;
+    for (size_t i = nextFrame; pinChange && i < frames.size(); i++) {
+        if (frames[i].startNs < nowNs) continue;
+        if (frames[i].startNs < wakeNs) {
+            wakeNs = frames[i].startNs;
+            frame = &frames[i];
+        }
+        break;
+    }
+    if (wakeNs == NEVER) {
+        fprintf(stderr, "sim: power-down without wake up source at %u ms\n", simMillis());
+        exit(2);
+    }
+#ifdef IR_EDGE_DECODER
+    // the leader edge itself wakes the CPU, delivered by serviceEvents()
+    (void)frame;
+    timer0PausedNs += wakeNs - nowNs;
+    nowNs = wakeNs;
+    powerDownEndNs = nowNs;
+#else
+    nowNs = wakeNs;
+    powerDownEndNs = nowNs;
+    if (frame) callISR(PCINT0_vect);
+#endif
+    serviceEvents();
+}
+
+void simSleep(uint8_t mode) {
+    // sleeping is not firmware time
+    loopSlept = true;
+    int depth = firmwareDepth;
+    if (depth) {
+        firmwareDepth = 1;
+        leaveFirmware();
+    }
+    if (mode == SLEEP_MODE_PWR_DOWN) {
+        powerDown();
+    } else {
+        simAdvance();
+    }
+    firmwareDepth = depth;
+    firmwareSince = HostClock::now();
+}
+
+// public interface
+
+void simPowerOn(const uint8_t *image) {
+    if (image) {
+        memcpy(eeprom, image, sizeof(eeprom));
+    } else {
+        memset(eeprom, 0xFF, sizeof(eeprom));
+    }
+    OCR1C = 255;
+    MCUSR = _BV(PORF);
+    EECR.onWrite = writeEECR;
+    WDTCR.onWrite = writeWDTCR;
+    PLLCSR.onWrite = writePLLCSR;
+    PINB.onWrite = writePINB;
+    PINB.value = _BV(PB2);                  // IR receiver output idle high
+
+    SimCommand boot = { SIM_BOOT, 0, 0, 0, -1, -1, 0, 0, 0, 0 };
+    commands.push_back(boot);
+    nextCommand = 1;
+    enterFirmware();
+    setup();
+    leaveFirmware();
+#ifdef IR_EDGE_DECODER
+    // count the frames the decoder completes, they are handed to the firmware unchanged
+    necFirmwareCallback = necCallback;
+    if (necFirmwareCallback) necCallback = countDecoded;
+#endif
+}
+
+void simKey(uint32_t timeMs, uint8_t command, uint16_t holdMs) {
+    SimCommand entry = { command, timeMs, 0, 0, -1, -1, 0, 0, 0, 0 };
+    commands.push_back(entry);
+    uint64_t start = timeMs * NS_PER_MS;
+    SimFrame frame = { start, start + NEC_FRAME_NS, command, false, commands.size() - 1 };
+    frames.push_back(frame);
+#ifdef IR_EDGE_DECODER
+    addEdges(frame);
+#endif
+    // a held key sends repeat frames
+    for (uint64_t next = start + NEC_PERIOD_NS; next < start + holdMs * NS_PER_MS; next += NEC_PERIOD_NS) {
+        frame.startNs = next;
+        frame.endNs = next + NEC_REPEAT_NS;
+        frame.repeat = true;
+        frames.push_back(frame);
+#ifdef IR_EDGE_DECODER
+        addEdges(frame);
+#endif
+    }
+}
+
+void simVcc(uint32_t timeMs, uint16_t mV, uint16_t rampMs) {
+    uint64_t start = timeMs * NS_PER_MS;
+    SimVccPoint from = { start, vccAt(start) };
+    SimVccPoint to = { start + rampMs * NS_PER_MS, mV };
+    vccPoints.push_back(from);
+    vccPoints.push_back(to);
+}
+
+static bool frameOrder(const SimFrame &a, const SimFrame &b) { return a.startNs < b.startNs; }
+static bool commandOrder(const SimCommand &a, const SimCommand &b) { return a.timeMs < b.timeMs; }
+
+void simRun(uint32_t untilMs) {
+    if (commands.empty()) simPowerOn();
+    if (!std::is_sorted(frames.begin() + nextFrame, frames.end(), frameOrder) ||
+        !std::is_sorted(commands.begin() + nextCommand, commands.end(), commandOrder)) {
+        fprintf(stderr, "sim: keys have to be scheduled in time order\n");
+        exit(2);
+    }
+    if (powerLostMs) return;
+    runUntilNs = untilMs * NS_PER_MS;
+    try {
+        while (nowNs < runUntilNs) {
+            commands[currentCommand].loops++;
+            enterFirmware();
+            loopSlept = false;
+            loop();
+            leaveFirmware();
+            // a main loop that went to sleep already waited for the next period
+            if (!loopSlept) simAdvance();
+        }
+    } catch (SimStop &) {
+        firmwareDepth = 0;
+        flushWindow();
+    }
+}
+
+uint32_t simMillis() {
+    return uint32_t(nowNs / NS_PER_MS);
+}
+
+uint32_t simPowerLost() {
+    return powerLostMs;
+}
+
+uint8_t *simEeprom() {
+    return eeprom;
+}
+
+void simEepromProgrammed() {
+    eepromWrites++;
+    if (!commands.empty()) commands[currentCommand].eepromWrites++;
+}
+
+const std::vector<SimSample> &simTimeline() { return timeline; }
+const std::vector<SimCommand> &simCommands() { return commands; }
+uint32_t simEepromWrites() { return eepromWrites; }
+uint32_t simFramesLost() { return framesLost; }
+
+// Arduino core
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (mode == OUTPUT) {
+        DDRB |= _BV(pin);
+    } else {
+        DDRB &= ~_BV(pin);
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (value) {
+        PORTB |= _BV(pin);
+    } else {
+        PORTB &= ~_BV(pin);
+    }
+}
+
+void delay(unsigned long ms) {
+    uint64_t end = nowNs + ms * NS_PER_MS;
+    while (nowNs < end) simAdvance();
+}
+
+void delayMicroseconds(unsigned int) {}
+
+#ifndef IR_EDGE_DECODER
+// IRMP, the edge decoder (src/necdecoder.cpp) brings its own
+
+void irmp_init() {}
+
+bool irmp_get_data(IRMP_DATA *data) {
+    if (!irmpAvailable) return false;
+    *data = irmpData;
+    irmpAvailable = false;
+    return true;
+}
+
+void irmp_register_complete_callback_function(void (*callback)(void)) {
+    irmpCallback = callback;
+}
+#endif
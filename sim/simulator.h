@@ -0,0 +1,67 @@
+/*
+ * Host simulation of the LED Lighting Controller.
+ *
+ * The firmware sources are compiled unchanged against the shim headers in sim/include, which map
+ * the ATtiny85 registers, EEPROM, sleep modes and IRMP onto this simulator. The simulator keeps
+ * the simulated time, runs the interrupt handlers (Timer1 overflow, WDT, EEPROM ready, pin change)
+ * when they are due, plays back NEC frames through the IRMP completion callback and records the
+ * PWM output of OC1A (cold white) and OC1B (warm white) as a timeline. With -D IR_EDGE_DECODER
+ * the frames are PB2 edges instead, decoded by src/necdecoder.cpp on Timer0 and pin change. The supply voltage can
+ * be scripted for the ADC (bandgap against Vcc); below 2.7 V the simulated CPU stops.
+ *
+ * The main loop runs once per Timer1 period, sleeping at its end until the next overflow; interrupts
+ * never preempt it. Times are in simulated milliseconds unless noted otherwise.
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <vector>
+
+// mean duty cycle of both PWM outputs (0..255) from `timeMs` on
+struct SimSample {
+    uint32_t timeMs;
+    float cold;
+    float warm;
+    uint32_t timeUs;        // start of the window in microseconds
+};
+
+// one IR command (a frame and its repeats) and what the firmware did in response
+struct SimCommand {
+    uint8_t command;
+    uint32_t timeMs;        // start of the first frame
+    uint16_t frames;        // frames decoded, including repeats
+    uint16_t lost;          // frames missed because the CPU was powered down
+    int32_t responseMs;     // first output change after the frame was decoded, -1 for none
+    int32_t settleMs;       // last output change before the next command, -1 for none
+    uint32_t loops;         // main loop iterations
+    uint32_t isrCalls;      // interrupt handler calls
+    uint32_t eepromWrites;  // EEPROM byte programs
+    uint64_t hostNs;        // host time spent in firmware code
+};
+
+struct SimConfig {
+    float wdtScale;         // WDT period relative to 1 s, the oscillator drifts by +-10%
+    uint32_t sampleUs;      // averaging window of the timeline; at or below one PWM period every
+                            // period is a sample with its OCR1A/OCR1B values, also when unchanged
+    uint16_t bandgapMv;     // bandgap of the simulated part, nominal 1100 mV +-10%
+};
+
+extern SimConfig simConfig;
+
+void simPowerOn(const uint8_t *eeprom = 0);
+void simKey(uint32_t timeMs, uint8_t command, uint16_t holdMs = 0);
+void simVcc(uint32_t timeMs, uint16_t mV, uint16_t rampMs = 0);
+void simRun(uint32_t untilMs);
+
+uint32_t simMillis();
+uint8_t *simEeprom();
+
+const std::vector<SimSample> &simTimeline();
+const std::vector<SimCommand> &simCommands();
+uint32_t simEepromWrites();
+uint32_t simFramesLost();
+uint32_t simPowerLost();    // time the supply fell below the CPU's minimum, 0 if never
+
+#endif
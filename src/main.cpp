@@ -29,346 +29,1098 @@
  */
 
 #define IRMP_SUPPORT_NEC_PROTOCOL 1 
+#define IRMP_USE_COMPLETE_CALLBACK 1 // decoded frames are queued from the IRMP interrupt
+#define F_INTERRUPTS 10000 // IRMP sample rate: its minimum is plenty for NEC, 2/3 of the default ISR load
 #define IR_RECEIVE_PIN 2 // PB2 on ATtiny85
 #define ARDUINO_AVR_DIGISPARK 1
 
 #include <Arduino.h>
 #include <EEPROM.h>
+#ifdef IR_EDGE_DECODER
+#include "necdecoder.h"
+#else
 #include <irmp.hpp>
+#endif
 #include <avr/io.h>
 #include <avr/wdt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+#include "timebase.h"
+#include "state.h"
+#include "profile.h"
 
-const unsigned long RESET_TIMEOUT_S = 2;            // brownout detection time horizont
-const unsigned long LIGHTOFF_TIMEOUT_S = 1800;      // 30min lights-off time-out
-const int EEPROM_COLD_WHITE_ADDR = 0;
-const int EEPROM_WARM_WHITE_ADDR = 1;
-const uint8_t MAGIC_VALUE = 0XAB; // magic value in SRAM  
-
-volatile unsigned long timeCounter = 0;
-volatile uint8_t resetMarker __attribute__((section(".noinit"))); // SRAM reset marker
-unsigned long restartDetectTimer = 0; 
-unsigned long lightOffTimer = 0; 
-uint8_t current_preset = 0;
-bool is_on = true;
-bool is_night = false;
-bool timer_start = false;
+const uint32_t RESET_TIMEOUT_S = 2;                 // brownout detection time horizont, a power cycle within it is another tap
+const uint8_t LIGHTOFF_STEPS = 4;                   // lights-off timer settings, cycled by the 30min key
+const uint8_t lightOffMinutes[LIGHTOFF_STEPS] = {15, 30, 60, 90};
+const uint16_t LIGHTOFF_FADE_MS = 60000;            // fade-out when the lights-off timer expires
+const uint32_t SUNRISE_KEY_S = 3;                   // 30min within 3 s after Night starts a sunrise instead of the timer
+const uint32_t SUNRISE_MS = 25UL * 60 * 1000;       // sunrise ramp from the deepest warm level to the saved color
+const uint8_t MIN_BRIGHTNESS = 2;                   // lowest lit level, a single dither step: the table maps 0 and 1 to off
+const uint8_t SUNRISE_BRIGHTNESS = MIN_BRIGHTNESS;  // sunrise start
+#ifdef POWER_FAIL_SAVE
+const uint32_t PERSIST_DELAY_S = 300;               // auto-save delay, the power fail save catches the rest (>= 20 ms hold-up)
+#else
+const uint32_t PERSIST_DELAY_S = 5;                 // auto-save delay after the last IR command
+#endif
+const uint8_t KEY_STEP = 4;                         // brightness/mix step of a single key press
+const uint8_t KEY_ACCEL = 3;                        // step growth per repeat frame while a key is held
+const uint8_t KEY_HOLD_MAX = 16;                    // repeat frames until the step stops growing
+const uint16_t BLINK_DARK_MS = 200;                 // acknowledgement blink: outputs off, then
+const uint16_t BLINK_LIT_MS = 200;                  // on again before the next blink of a series
+const uint16_t IR_WAKE_MS = 200;                    // stay awake after an IR wake-up to decode the frame and a repeat
+const int EEPROM_LOG_ADDR = 0;                      // start of the settings ring log
+const uint8_t EEPROM_LOG_SLOTS = 96;                // 96 * 5 bytes, top 32 bytes of the EEPROM stay free
+const int EEPROM_PRESET_ADDR = 480;                 // user presets and their CRC8, right after the log
+const uint8_t PRESET_COUNT = 5;                     // color temperature presets, cycled by the Lamp key
+const uint32_t PRESET_SAVE_S = 3;                   // Lamp within 3 s after D1 saves the color into the preset
+const int EEPROM_CALIBRATION_ADDR = 486;            // LED and bandgap calibration and its CRC8, after the presets
+// CRC8 start values of the EEPROM blocks: neither zeroed (0x00) nor erased (0xFF) cells pass
+const uint8_t LOG_SEED = 0x5A;
+const uint8_t PRESET_SEED = 0xA5;
+const uint8_t CALIBRATION_SEED = 0xC3;
+#ifdef PWM_PLL_PRESCALER
+const uint32_t PWM_CLOCK = 64000000UL / PWM_PLL_PRESCALER;  // Timer1 clock from the PLL
+const uint16_t PWM_PRESCALER = PWM_PLL_PRESCALER;
+static_assert(PWM_PLL_PRESCALER == 4 || PWM_PLL_PRESCALER == 8 || PWM_PLL_PRESCALER == 16,
+              "PLL prescaler: 16, 8 or 4 (15.6, 31 or 62 kHz PWM), use CK/16 for slower PWM");
+#else
+const uint32_t PWM_CLOCK = F_CPU / 16;             // Timer1 clock CK/16
+const uint16_t PWM_PRESCALER = 16;
+#endif
+const uint16_t PWM_OVF_HZ = PWM_CLOCK / 256;        // Timer1 overflow rate (OCR1C = 255)
+// above 15.6 kHz the overflow ISR only counts down, every PWM_OVF_DIVIDER-th period it dithers
+// and ticks: the hardware repeats the duty cycles in between
+const uint8_t PWM_OVF_DIVIDER = PWM_OVF_HZ > 15625 ? PWM_OVF_HZ / 15625 : 1;
+const uint16_t PWM_TICK_HZ = PWM_OVF_HZ / PWM_OVF_DIVIDER;     // dithering and millisecond tick rate
+// CPU cycles between two dithering steps: the ISR needs ~100 for the dithering and the tick, the
+// ~400 for a fade step once per ms may span periods (see TIMER1_OVF_vect), IRMP takes ~150 every
+// 100 us on top; a counted-down period costs ~25 cycles of 128 at 62 kHz
+const uint16_t PWM_TICK_CYCLES = F_CPU / PWM_TICK_HZ;
+static_assert(PWM_TICK_CYCLES >= 512, "PWM too fast: the Timer1 overflow ISR would miss periods");
+#ifdef PWM_PLL_PRESCALER
+const uint8_t DITHER_BITS = 4;                      // dithered fraction bits: 12 bit resolution, >= 977 Hz dither rate
+#else
+const uint8_t DITHER_BITS = 3;                      // dithered fraction bits: 11 bit resolution, >= 244 Hz dither rate
+#endif
+const uint8_t DITHER_MASK = uint8_t(0xFF00 >> DITHER_BITS);
+const uint16_t DITHER_STEP = 0x100 >> DITHER_BITS;  // smallest 8.8 duty cycle the dithering can resolve
+const uint8_t NIGHT_BRIGHTNESS = 39;                // nightlight level, ~5/255 duty cycle after gamma correction
+const uint8_t NIGHT_MIX = 255;                      // nightlight color: warm white only
+#ifdef POWER_FAIL_SAVE
+const uint16_t VCC_FAIL_MV = 4300;                  // supply dropping: cut the load and save
+const uint16_t VCC_RECOVER_MV = 4600;               // back to normal after a short dip
+const uint8_t VCC_FAIL_SAMPLES = 4;                 // consecutive low readings, ~1 ms
+#endif
+
+// boot modes of 1, 2, 3 quick power cycles with the wall switch, more taps stay at the last one
+enum TapMode : uint8_t {
+    TAP_SAVED,              // saved color and mode
+    TAP_NIGHT,              // nightlight
+    TAP_FULL_COLD           // 100% cold white
+};
+
+const uint8_t tapModes[] PROGMEM = {TAP_SAVED, TAP_NIGHT, TAP_FULL_COLD};
+const uint8_t TAP_COUNT = sizeof(tapModes);
+
+volatile struct ResetMarker resetMarker __attribute__((section(".noinit"))); // SRAM reset marker, valid for RESET_TIMEOUT_S after boot
+bool markerCleared;                             // the reset marker expired after RESET_TIMEOUT_S
+uint32_t lightOffTimer = 0; 
+bool persist_pending = false;
+uint32_t persistTimer = 0;
+volatile bool irWakeup = false;         // set by the IR pin change interrupt in standby
+#ifdef POWER_FAIL_SAVE
+volatile bool powerFail = false;        // set by the ADC interrupt when the supply drops
+uint8_t vccLow = 0;                     // consecutive low readings, ADC ISR only
+uint16_t vccFail;                       // VCC_FAIL_MV and VCC_RECOVER_MV as ADC readings of the
+uint16_t vccRecover;                    // trimmed bandgap, set by loadCalibration()
+#endif
+uint16_t irWakeTime = 0;
+
+// acknowledgement blinks, stepped by the main loop; the lamp keeps its color and any running fade,
+// the Timer1 overflow ISR only forces the outputs off while blinkDark is set
+struct BlinkState {
+    uint8_t count;          // dark phases left, including the current one; 0 = no blink
+    uint16_t darkMs;
+    uint16_t start;         // msTicks() at the start of the current phase
+};
+struct BlinkState blink;
+volatile bool blinkDark = false;
 
 IRMP_DATA irmp_data;
 
+// decoded IR command, repeat frames of the same key are merged into one event
+struct IREvent {
+    uint8_t key;            // keymap[] index
+    uint8_t step;           // brightness/mix step, summed over all merged frames
+};
+
+const uint8_t IR_QUEUE_SIZE = 4;            // power of two
+volatile struct IREvent irQueue[IR_QUEUE_SIZE];
+volatile uint8_t irHead = 0;                // written by the IRMP callback
+volatile uint8_t irTail = 0;                // written by the main loop
+uint8_t irHold = 0;                         // consecutive repeat frames of the held key, IRMP callback only
+
 struct PWMdata {
     uint8_t coldWhite;
     uint8_t warmWhite;
 };
 
-struct PWMdata whiteColor = {128, 128};
-uint8_t brightness = 128;
+// easing curves of a fade, see fadeCurves[]
+enum FadeCurve : uint8_t {
+    FADE_LINEAR,            // constant speed, already perceptually even thanks to the CIE1931 table
+    FADE_EASE_IN_OUT,       // smoothstep, soft start and end
+    FADE_EASE_OUT,          // fast start, soft end
+    FADE_CURVES
+};
+
+const uint32_t FADE_PHASE_END = 1UL << 31;     // fade progress 0..FADE_PHASE_END, fine enough for exact long fades
+
+// state of the background fade, advanced every millisecond by the Timer1 overflow interrupt
+struct FadeState {
+    struct PWMdata start;
+    struct PWMdata target;
+    uint32_t phase;         // progress, FADE_PHASE_END = done
+    uint32_t phaseStep;     // progress per millisecond
+    uint8_t curve;
+    bool active;            // false = no fade in progress
+};
+
+volatile struct FadeState fade;
+volatile struct PWMdata output;     // logical (not gamma corrected) color written to the timer
+volatile uint16_t dutyCold = 0;     // gamma corrected 8.8 duty cycles, dithered by the Timer1 overflow ISR
+volatile uint16_t dutyWarm = 0;
+uint8_t ditherCold = 0;             // sigma-delta accumulators, Timer1 overflow ISR only
+uint8_t overflowCount = PWM_OVF_DIVIDER;   // Timer1 overflows until the next dithering step
+uint8_t ditherWarm = 0;
+
+// one entry of the wear-leveled settings log in EEPROM
+struct LogRecord {
+    uint8_t seq;            // incremented with every store, the newest record ends the sequence
+    struct ControllerState state;   // packState() image
+    uint8_t check;          // CRC8 over the bytes above
+};
+
+uint8_t logSlot = EEPROM_LOG_SLOTS - 1;     // slot of the newest record, the next store uses the one after it
+bool logValid = false;                      // a valid record was found in the log
+struct LogRecord logRecord;                 // copy of the newest record, the log is only read at boot
+
+// byte writes waiting for the EEPROM, served by the EEPROM ready interrupt
+struct EepromWrite {
+    uint16_t addr;
+    uint8_t data;
+};
+
+const uint8_t EEPROM_QUEUE_SIZE = 8;        // power of two
+volatile struct EepromWrite eepromQueue[EEPROM_QUEUE_SIZE];
+volatile uint8_t eepromHead = 0;            // written by the main loop
+volatile uint8_t eepromTail = 0;            // written by the ISR
+
+// default color temperatures (mix) of the presets, used until the user saves their own
+const uint8_t presetDefaults[PRESET_COUNT] PROGMEM = {
+    0,          // Preset 0 (255,   1)
+    64,         // Preset 1 (255, 128)
+    128,        // Preset 2 (255, 255)
+    191,        // Preset 3 (128, 255)
+    255         // Preset 4 (  1, 255)
+};
+
+uint8_t presets[PRESET_COUNT];              // active presets, read from EEPROM once at boot
+
+// LED calibration, part of the EEPROM image (avrdude -U eeprom); an invalid block means no correction
+struct Calibration {
+    uint8_t gainCold;       // duty cycle scale of each string, 255 = 1.0: evens out their efficacy
+    uint8_t gainWarm;
+    uint8_t maxCold;        // duty cycle limit of each string after the gain
+    uint8_t maxWarm;
+    uint8_t budget;         // combined power cap: cold + warm <= 2 * budget, 255 = no cap
+    int8_t bandgapTrim;     // measured bandgap - 1100 mV, in mV: it varies by +-10% between parts
+};
+
+const struct Calibration calibrationDefaults PROGMEM = {255, 255, 255, 255, 255, 0};
+
+// one string after loadCalibration(), so that writePWM() is a multiply and a compare per channel
+struct ChannelCalibration {
+    uint8_t gain;
+    uint16_t limit;         // 8.8 duty cycle limit, max << 8
+    uint8_t maxLevel;       // highest logical level within the limit, setBrightness() clamps to it
+};
+
+struct ChannelCalibration calCold = {255, 255 << 8, 255};
+struct ChannelCalibration calWarm = {255, 255 << 8, 255};
+uint16_t powerBudget = 255 << 8;            // cold / 2 + warm / 2 limit, enforced by setBrightness()
+
+// Timer1 clock select bits CS13..CS10 for a prescaler of 2^(n-1)
+constexpr uint8_t timer1ClockSelect(uint16_t prescaler) {
+    return prescaler <= 1 ? 1 : 1 + timer1ClockSelect(prescaler / 2);
+}
+
+// CIE1931 lightness -> luminance, evaluated by the compiler for the lookup table below
+constexpr double cieLuminance(double L) {
+    return L <= 8.0 ? L / 903.3 : ((L + 16.0) / 116.0) * ((L + 16.0) / 116.0) * ((L + 16.0) / 116.0);
+}
+
+// 8.8 fixed point duty cycle; 0 and 1 are both "off" (see setPWM), every other level keeps at least
+// the smallest step the dithering can resolve
+constexpr uint16_t cieDuty(uint8_t level) {
+    return level < 2 ? 0 : (cieLuminance(level * 100.0 / 255.0) * 65280.0 < DITHER_STEP ? DITHER_STEP :
+                            uint16_t(cieLuminance(level * 100.0 / 255.0) * 65280.0 + 0.5));
+}
+
+// easing curves, sampled at 17 points and interpolated in between
+constexpr double easeCurve(uint8_t curve, double x) {
+    return curve == FADE_EASE_IN_OUT ? x * x * (3.0 - 2.0 * x) :
+           curve == FADE_EASE_OUT    ? 1.0 - (1.0 - x) * (1.0 - x) :
+                                       x;
+}
 
-const uint8_t presets[5][2] = {
-    {255, 1},   // Preset 0
-    {255, 128}, // Preset 1
-    {255, 255}, // Preset 2
-    {128, 255}, // Preset 3
-    {1, 255}    // Preset 4
+constexpr uint8_t easePoint(uint8_t curve, uint8_t i) {
+    return uint8_t(easeCurve(curve, i / 16.0) * 255.0 + 0.5);
+}
+
+#define EASE17(c) { easePoint(c, 0),  easePoint(c, 1),  easePoint(c, 2),  easePoint(c, 3),  \
+                    easePoint(c, 4),  easePoint(c, 5),  easePoint(c, 6),  easePoint(c, 7),  \
+                    easePoint(c, 8),  easePoint(c, 9),  easePoint(c, 10), easePoint(c, 11), \
+                    easePoint(c, 12), easePoint(c, 13), easePoint(c, 14), easePoint(c, 15), \
+                    easePoint(c, 16) }
+
+const uint8_t fadeCurves[FADE_CURVES][17] PROGMEM = {
+    EASE17(FADE_LINEAR), EASE17(FADE_EASE_IN_OUT), EASE17(FADE_EASE_OUT)
+};
+
+#define CIE4(n)   cieDuty(n), cieDuty(n + 1), cieDuty(n + 2), cieDuty(n + 3)
+#define CIE16(n)  CIE4(n), CIE4(n + 4), CIE4(n + 8), CIE4(n + 12)
+#define CIE64(n)  CIE16(n), CIE16(n + 16), CIE16(n + 32), CIE16(n + 48)
+
+// perceptual brightness (0-255) to 8.8 PWM duty cycle (0-255.0)
+const uint16_t gammaTable[256] PROGMEM = {
+    CIE64(0), CIE64(64), CIE64(128), CIE64(192)
 };
 
 
 // Declaration of functions
-void mdelay(uint16_t time);
-struct PWMdata setBrightness(uint8_t brightness,  struct PWMdata white);
-void fadePWM(struct PWMdata start, struct PWMdata stop, int16_t durationMs = 800);
+uint8_t scale8(uint8_t value, uint8_t scale);
+struct PWMdata setBrightness(uint8_t brightness, uint8_t mix);
+struct PWMdata colorPWM(struct ColorState color);
+struct PWMdata mixLevel(uint8_t level, uint8_t coldGain, uint8_t warmGain);
+bool withinBudget(struct PWMdata white);
+void fadePWM(struct PWMdata start, struct PWMdata stop, uint32_t durationMs = 800, uint8_t curve = FADE_LINEAR);
+void fadeTo(struct PWMdata stop, uint32_t durationMs = 800, uint8_t curve = FADE_LINEAR);
+uint8_t fadeEase(uint8_t curve, uint32_t phase);
+uint8_t fadeChannel(uint8_t start, uint8_t stop, uint8_t eased);
 void setupPWM();
 void setPWM(struct PWMdata white);
-void processNECCommand(uint16_t command);
-struct PWMdata readColor();
-uint8_t getBrightness(struct PWMdata color);    
-
-
-void mdelay(uint16_t time) {
-    for (uint16_t j = 1; j<time; j++) {
-        // delay loop for approx. 1ms @ 8Mhz 
-        for (uint16_t i = 0; i < 700; i++) {
-            __asm__ __volatile__ (
-                "nop\n\t"
-                "nop\n\t"
-                "nop\n\t" 
-                "nop\n\t" 
-                "nop\n\t" 
-                "nop\n\t" 
-                "nop\n\t" 
-                "nop\n\t" 
-            );    
-        }
+void writePWM(struct PWMdata white);
+struct PWMdata getPWM();
+bool fadeActive();
+uint8_t ditherDuty(uint16_t duty, uint8_t *acc);
+uint16_t scaleDuty(uint16_t duty, uint8_t scale);
+uint16_t calibratedDuty(uint8_t level, const struct ChannelCalibration *channel);
+void processKey(uint8_t key, uint8_t step = KEY_STEP);
+uint8_t findKey(uint16_t address, uint16_t command);
+void keyPower(uint8_t param, uint8_t step);
+void keyPreset(uint8_t param, uint8_t step);
+void keyBrighter(uint8_t param, uint8_t step);
+void keyDarker(uint8_t param, uint8_t step);
+void keyColder(uint8_t param, uint8_t step);
+void keyWarmer(uint8_t param, uint8_t step);
+void keyNight(uint8_t param, uint8_t step);
+void keyLevel(uint8_t param, uint8_t step);
+void keyStore(uint8_t param, uint8_t step);
+void keyTimer(uint8_t param, uint8_t step);
+void handleIRData();
+bool getIREvent(struct IREvent *event);
+void storeState();
+void scanLog();
+void loadPresets();
+void savePreset();
+uint8_t presetChecksum();
+void loadCalibration();
+void prepareChannel(struct ChannelCalibration *channel, uint8_t gain, uint8_t max);
+void schedulePersist();
+void persistState();
+void persistRecord();
+bool readLogRecord(uint8_t slot, struct LogRecord *record);
+uint8_t logChecksum(const struct LogRecord *record);
+void eepromWrite(uint16_t addr, uint8_t data);
+bool eepromBusy();
+void eepromFlush();
+bool standbyAllowed();
+void enterStandby();
+void setupPowerMonitor();
+void powerFailSave();
+void startBlink(uint8_t count, uint16_t darkMs = BLINK_DARK_MS);
+void updateBlink();
+
+// one key of a remote: NEC address and command, what it does and whether it repeats while held
+typedef void (*KeyHandler)(uint8_t param, uint8_t step);
+
+struct KeyEntry {
+    uint8_t address;
+    uint8_t command;
+    uint8_t flags;          // KEY_* bits
+    uint8_t param;          // passed to the handler, e.g. the brightness of a level key
+    KeyHandler handler;
+};
+
+const uint8_t KEY_REPEAT = 0x01;           // repeat frames while held, with acceleration
+const uint8_t KEY_NONE = 0xFF;             // findKey(): not in the keymap
+
+// Lidl remote, see doc/ir-codes. A second remote or a remapped button is just another entry.
+const struct KeyEntry keymap[] PROGMEM = {
+    {0x00, 69, 0,          0,   keyPower},      // on/off
+    {0x00, 71, 0,          0,   keyPreset},     // Lamp
+    {0x00,  9, KEY_REPEAT, 0,   keyBrighter},   // high
+    {0x00,  7, KEY_REPEAT, 0,   keyDarker},     // low
+    {0x00, 25, KEY_REPEAT, 0,   keyColder},     // cold
+    {0x00, 64, KEY_REPEAT, 0,   keyWarmer},     // warm
+    {0x00,  8, 0,          0,   keyNight},      // Night
+    {0x00, 12, 0,          96,  keyLevel},      // 10% duty cycle, 38% lightness
+    {0x00, 24, 0,          194, keyLevel},      // 50% duty cycle, 76% lightness
+    {0x00, 94, 0,          255, keyLevel},      // 100%
+    {0x00, 28, 0,          0,   keyStore},      // D1
+    {0x00, 90, 0,          0,   keyTimer},      // 30min
+};
+
+const uint8_t KEY_COUNT = sizeof(keymap) / sizeof(keymap[0]);
+static_assert(KEY_COUNT < KEY_NONE, "keymap too large");
+
+KeyHandler lastHandler = 0;                 // handler of the previous key, for key sequences
+uint32_t lastKeyTime = 0;                   // seconds() after the previous key
+
+
+uint8_t scale8(uint8_t value, uint8_t scale) {
+    // value * scale / 256 rounded up: one 8x8->16 bit mul, 255 * 255 stays 255
+    return uint8_t((uint16_t(value) * scale + 255) >> 8);
+}
+
+struct PWMdata setBrightness(uint8_t brightness, uint8_t mix) {
+    PROFILE_SCOPE(PROFILE_BRIGHTNESS);
+    // the dominant string runs at full brightness, the other one is scaled down by the mix
+    uint8_t coldGain = (mix <= 128) ? 255 : uint8_t((255 - mix) << 1);
+    uint8_t warmGain = (mix >= 128) ? 255 : uint8_t(mix << 1);
+    struct PWMdata white = mixLevel(brightness, coldGain, warmGain);
+    if (withinBudget(white)) return white;
+
+    // power cap: the highest brightness of this mix within the budget, found by bisection.
+    // The calibrated duty is convex in the level below maxLevel, so a fade between two
+    // colors within the cap stays within it and the ISR doesn't need to check.
+    uint8_t low = 0;
+    uint8_t high = brightness - 1;
+    while (low < high) {
+        uint8_t level = high - ((high - low) >> 1);
+        if (withinBudget(mixLevel(level, coldGain, warmGain))) low = level; else high = level - 1;
     }
+    return mixLevel(low, coldGain, warmGain);
 }
 
-struct PWMdata setBrightness(uint8_t brightness, struct PWMdata white) {
-    uint16_t newColdWhitePWM;
-    uint16_t newWarmWhitePWM;
+struct PWMdata mixLevel(uint8_t level, uint8_t coldGain, uint8_t warmGain) {
+    // both strings at their share of the level, clamped to their duty cycle limit
+    struct PWMdata white = {scale8(level, coldGain), scale8(level, warmGain)};
+    if (white.coldWhite > calCold.maxLevel) white.coldWhite = calCold.maxLevel;
+    if (white.warmWhite > calWarm.maxLevel) white.warmWhite = calWarm.maxLevel;
+    return white;
+}
 
-    // increase integer mathematics accuracy by using scaling
-    const uint16_t scaleFactor = 100;
+bool withinBudget(struct PWMdata white) {
+    // without a cap two duty cycles can't exceed it, no table lookups
+    if (powerBudget == 255 << 8) return true;
+    return (calibratedDuty(white.coldWhite, &calCold) >> 1) + (calibratedDuty(white.warmWhite, &calWarm) >> 1) <= powerBudget;
+}
 
-    if (white.coldWhite >= white.warmWhite) {
-        newColdWhitePWM = brightness;
-        // add 9/10th of the divisor to the divident for better rounding results
-        uint16_t temp = (uint16_t(white.coldWhite) * scaleFactor + ((uint16_t(white.warmWhite) * 9) / 10)) / uint16_t(white.warmWhite);
-        newWarmWhitePWM = (brightness * scaleFactor + ((temp * 9) / 10)) / temp;
+struct PWMdata colorPWM(struct ColorState color) {
+    return setBrightness(color.brightness, color.mix);
+}
 
-    } else {
-        newWarmWhitePWM = brightness;
-        // add 9/10th of the divisor to the divident for better rounding results
-        uint16_t temp = (uint16_t(white.warmWhite) * scaleFactor + ((uint16_t(white.coldWhite) * 9) / 10)) / uint16_t(white.coldWhite);
-        newColdWhitePWM = (brightness * scaleFactor + ((temp * 9) / 10)) / temp;
+void fadePWM(struct PWMdata start, struct PWMdata stop, uint32_t durationMs, uint8_t curve) {
+    // stop a running fade before its parameters are replaced
+    fade.active = false;
+    if (durationMs == 0) {
+        writePWM(stop);
+        return;
     }
-    // check valid parameter range (1-255)
-    return {uint8_t(constrain(newColdWhitePWM, 1, 255)), uint8_t(constrain(newWarmWhitePWM, 1, 255))};
-}
 
-void fadePWM(struct PWMdata start, struct PWMdata stop, int16_t durationMs) {
-    // Anzahl der Schritte (z. B. 50 Schritte für sanftes Fading)
-    const int16_t steps = 50;
-    // single step duration in milliseconds
-    int16_t stepDelay = durationMs / steps;
+    // the fade takes durationMs no matter how far the channels have to travel; the rounded step
+    // is off by at most durationMs / 2^32 relative, 0.35 s of a 25 min sunrise
+    fade.start.coldWhite = start.coldWhite;
+    fade.start.warmWhite = start.warmWhite;
+    fade.target.coldWhite = stop.coldWhite;
+    fade.target.warmWhite = stop.warmWhite;
+    fade.phase = 0;
+    fade.phaseStep = (FADE_PHASE_END + durationMs / 2) / durationMs;
+    fade.curve = curve;
+    writePWM(start);
 
-    // step size per channel
-    int16_t stepCold = (int16_t(stop.coldWhite) - int16_t(start.coldWhite)) / steps;
-    int16_t stepWarm = (int16_t(stop.warmWhite) - int16_t(start.warmWhite)) / steps;
+    // arm the ISR last, it ignores the fade data as long as active is false
+    fade.active = true;
+}
 
-    // initialize start values
-    int16_t currentCold = start.coldWhite;
-    int16_t currentWarm = start.warmWhite;
+void fadeTo(struct PWMdata stop, uint32_t durationMs, uint8_t curve) {
+    // freeze a running fade and continue from the color that is visible right now
+    fade.active = false;
+    fadePWM(getPWM(), stop, durationMs, curve);
+}
 
-    for (uint16_t i = 0; i <= steps; i++) {
-        // set current color temperature values
-        setPWM((PWMdata){
-            uint8_t(constrain(currentCold, 1, 255)),
-            uint8_t(constrain(currentWarm, 1, 255))
-        });
-        // next fading increment/decrement
-        currentCold += stepCold;
-        currentWarm += stepWarm;
+uint8_t fadeEase(uint8_t curve, uint32_t phase) {
+    // 16 segments of the curve, linear interpolation inside a segment
+    uint8_t segment = phase >> 27;
+    uint8_t fraction = phase >> 19;
+    uint8_t a = pgm_read_byte(&fadeCurves[curve][segment]);
+    uint8_t b = pgm_read_byte(&fadeCurves[curve][segment + 1]);
+    return a + uint8_t((uint16_t(b - a) * fraction) >> 8);
+}
 
-        // Delay per single fading step
-        mdelay(stepDelay);
-    }
+uint8_t fadeChannel(uint8_t start, uint8_t stop, uint8_t eased) {
+    // start + (stop - start) * eased / 256 without signed or 16x16 bit math
+    if (stop >= start) return start + scale8(stop - start, eased);
+    return start - scale8(start - stop, eased);
+}
 
-    // To cover rounding problems set stop color temperatur at the end
-    setPWM(stop);
+bool fadeActive() {
+    return fade.active;
 }
 
 void setupPWM() {
     // Set PB1 and PB4 as outputs
     DDRB |= (1 << PB1) | (1 << PB4);
 
+#ifdef PWM_PLL_PRESCALER
+    // Start the PLL and switch Timer1 to the 64 MHz clock once it is locked
+    PLLCSR = (1 << PLLE);
+    _delay_us(100);
+    while (!(PLLCSR & (1 << PLOCK)));
+    PLLCSR |= (1 << PCKE);
+#endif
+
     // Configure Timer1 for Fast PWM mode
-    TCCR1 = (1 << CTC1) | (1 << COM1A1) |(1 << PWM1A) | (1 << CS12) |  (0 << CS11) | (1 << CS10); // Enable Fast PWM on OC1A
+    TCCR1 = (1 << CTC1) | (1 << COM1A1) |(1 << PWM1A) | timer1ClockSelect(PWM_PRESCALER); // Enable Fast PWM on OC1A
     GTCCR = (1 << COM1B1) | (1 << PWM1B);                                                         // Enable Fast PWM on OC1B
 
     // Set the PWM frequency by setting OCR1C (TOP value)
     OCR1C = 255; // Maximum resolution (8-bit, 0-255)
+
+    // Timer1 overflow interrupt drives the background fade
+    TIMSK |= (1 << TOIE1);
 }
 
 void setPWM(struct PWMdata white) {
-    if (white.coldWhite == 1) OCR1A = 0; else OCR1A = white.coldWhite; // Duty cycle for PB1 (0, 1-255)
-    if (white.warmWhite == 1) OCR1B = 0; else OCR1B = white.warmWhite; // Duty cycle for PB4 (0, 1-255)
-}
-
-void processNECCommand(uint16_t command) {
-    const uint16_t increment = 4;
-    struct PWMdata newColor;
-
-    switch (command) {
-        case 69: // On-Off toggle
-            is_on = !is_on;
-            if (is_on) {
-                fadePWM((PWMdata){0,0}, whiteColor);
-            } else {
-                fadePWM(whiteColor, (PWMdata){0,0});
-            }
-            break;   
-
-        case 71: // Select presettings 0..4
-            current_preset = (current_preset + 1) % 5;
-            newColor = setBrightness(brightness, (PWMdata){presets[current_preset][0], presets[current_preset][1]});
-            fadePWM(whiteColor, newColor);
-            whiteColor = newColor;
-            break;
+    // a direct write from the main loop cancels a running fade
+    fade.active = false;
+    writePWM(white);
+}
 
-        case 9: // brighter
-            if (brightness < (255-increment)) brightness += increment; else brightness = 255;
-            whiteColor = setBrightness(brightness, whiteColor);
-            setPWM(whiteColor);
-            break;
+void writePWM(struct PWMdata white) {
+    output.coldWhite = white.coldWhite;
+    output.warmWhite = white.warmWhite;
+    // gamma correction and calibration, the power cap is already part of the color
+    uint16_t cold = calibratedDuty(white.coldWhite, &calCold);
+    uint16_t warm = calibratedDuty(white.warmWhite, &calWarm);
+    // OCR1A/OCR1B are updated from these by the Timer1 overflow ISR
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        dutyCold = cold;
+        dutyWarm = warm;
+    }
+}
 
-        case 7: // darker
-            if (brightness >= increment) brightness -= increment; else brightness = 0;
-            whiteColor = setBrightness(brightness, whiteColor);
-            setPWM(whiteColor);
-            break;
+uint8_t ditherDuty(uint16_t duty, uint8_t *acc) {
+    // first order sigma-delta: the carry of the fraction accumulator selects the next higher
+    // duty cycle for this period, the average over 2^DITHER_BITS periods matches the 8.8 value
+    uint8_t fraction = uint8_t(duty) & DITHER_MASK;
+    uint8_t sum = *acc + fraction;
+    uint8_t out = duty >> 8;
+    if (sum < *acc) out++;      // no overflow, 255.0 is the largest table value
+    *acc = sum;
+    return out;
+}
 
-        case 25: // colder white
-            if (whiteColor.coldWhite < (255-increment)) whiteColor.coldWhite += increment; else whiteColor.coldWhite = 255;
-            if (whiteColor.warmWhite >= increment) whiteColor.warmWhite -= increment; else whiteColor.warmWhite = 0;
-            if (whiteColor.coldWhite == 0) whiteColor.coldWhite = 1; 
-            if (whiteColor.warmWhite == 0) whiteColor.warmWhite = 1; 
-            if (whiteColor.coldWhite > whiteColor.warmWhite) {
-                brightness = whiteColor.coldWhite;
-            } else {
-                brightness = whiteColor.warmWhite;
-            }
-            setPWM(whiteColor);
-            break;
+uint16_t scaleDuty(uint16_t duty, uint8_t scale) {
+    // duty * scale / 256 with two 8x8 bit multiplications; 255 keeps the duty cycle, a lit
+    // channel stays at least at the dithering resolution
+    if (scale == 255 || duty == 0) return duty;
+    uint16_t scaled = uint8_t(duty >> 8) * scale + ((uint8_t(duty) * scale) >> 8);
+    return scaled < DITHER_STEP ? DITHER_STEP : scaled;
+}
 
-        case 64: // warmer white
-            if (whiteColor.warmWhite < (255-increment)) whiteColor.warmWhite += increment; else whiteColor.warmWhite = 255;
-            if (whiteColor.coldWhite >= increment) whiteColor.coldWhite -= increment; else whiteColor.coldWhite = 0;
-            if (whiteColor.coldWhite == 0) whiteColor.coldWhite = 1; 
-            if (whiteColor.warmWhite == 0) whiteColor.warmWhite = 1;
-            if (whiteColor.coldWhite > whiteColor.warmWhite) {
-                brightness = whiteColor.coldWhite;
-            } else {
-                brightness = whiteColor.warmWhite;
-            } 
-            setPWM(whiteColor);
-            break;
+uint16_t calibratedDuty(uint8_t level, const struct ChannelCalibration *channel) {
+    // the table maps 0 and 1 to duty cycle 0, then the gain of the string and its limit
+    uint16_t duty = scaleDuty(pgm_read_word(&gammaTable[level]), channel->gain);
+    return duty > channel->limit ? channel->limit : duty;
+}
 
-        case 8: // Nightlight
-            is_night = !is_night;
-            if (is_night) {
-                fadePWM(whiteColor, setBrightness(5, (PWMdata){presets[4][0], presets[4][1]}));
-            } else {
-                whiteColor = readColor();
-                brightness = getBrightness(whiteColor);
-                fadePWM(setBrightness(5, (PWMdata){presets[4][0], presets[4][1]}), whiteColor);
-            }
-            break;
+struct PWMdata getPWM() {
+    // color that produced the live OCR1A/OCR1B duty cycles
+    return (PWMdata){output.coldWhite, output.warmWhite};
+}
 
-        case 12: // 10%
-            newColor = setBrightness(25, whiteColor);   // 25 = 10% of 255
-            fadePWM(whiteColor, newColor); 
-            whiteColor = newColor;
-            break;
+void processKey(uint8_t key, uint8_t step) {
+    PROFILE_SCOPE(PROFILE_COMMAND);
+    KeyHandler handler = (KeyHandler)pgm_read_ptr(&keymap[key].handler);
+    handler(pgm_read_byte(&keymap[key].param), step);
+    lastHandler = handler;
+    lastKeyTime = seconds();
+}
 
-        case 24: // 50%
-            newColor = setBrightness(128, whiteColor);  // 128 = 50% of 255
-            fadePWM(whiteColor, newColor); 
-            whiteColor = newColor;
-            break;
+uint8_t findKey(uint16_t address, uint16_t command) {
+    for (uint8_t key = 0; key < KEY_COUNT; key++) {
+        if (pgm_read_byte(&keymap[key].command) == command &&
+            pgm_read_byte(&keymap[key].address) == address) {
+            return key;
+        }
+    }
+    return KEY_NONE;
+}
 
-        case 94: // 100%
-            newColor = setBrightness(255, whiteColor);  // 255 = 100% of 255
-            fadePWM(whiteColor, newColor); 
-            whiteColor = newColor;
-            break;
+void keyPower(uint8_t, uint8_t) {
+    // On-Off toggle
+    state.off = !state.off;
+    if (!state.off) {
+        fadeTo(colorPWM(state.color), 800, FADE_EASE_IN_OUT);
+    } else {
+        fadeTo((PWMdata){0,0}, 800, FADE_EASE_IN_OUT);
+    }
+}
 
-        case 28: // D1: Store current color temperatur
-            EEPROM.update(EEPROM_COLD_WHITE_ADDR, whiteColor.coldWhite);
-            EEPROM.update(EEPROM_WARM_WHITE_ADDR, whiteColor.warmWhite);
-            setPWM((PWMdata){0,0});
-            mdelay(200);
-            setPWM(whiteColor);
-            break;
+void keyPreset(uint8_t, uint8_t) {
+    // D1, Lamp: save the current color temperature into the active preset
+    if (lastHandler == keyStore && !secondsPassed(lastKeyTime, PRESET_SAVE_S)) {
+        savePreset();
+        startBlink(1);
+        return;
+    }
+    // Select presettings 0..4
+    state.preset = (state.preset + 1) % PRESET_COUNT;
+    state.color.mix = presets[state.preset];
+    fadeTo(colorPWM(state.color));
+}
 
-        case 90: // 30 min timer
-            timer_start = !timer_start;
-            lightOffTimer = timeCounter;
-            setPWM((PWMdata){0,0});
-            if (timer_start) {
-                mdelay(200);
-            } else {
-                mdelay(800);
-            }
-            setPWM(whiteColor);
-            break;
+void keyBrighter(uint8_t, uint8_t step) {
+    if (state.color.brightness + step < 255) state.color.brightness += step; else state.color.brightness = 255;
+    setPWM(colorPWM(state.color));
+}
+
+void keyDarker(uint8_t, uint8_t step) {
+    // stop at the lowest lit level, on/off is the only way to dark
+    if (state.color.brightness >= MIN_BRIGHTNESS + step) state.color.brightness -= step; else state.color.brightness = MIN_BRIGHTNESS;
+    setPWM(colorPWM(state.color));
+}
+
+void keyColder(uint8_t, uint8_t step) {
+    // colder white, brightness is kept
+    if (state.color.mix >= step) state.color.mix -= step; else state.color.mix = 0;
+    setPWM(colorPWM(state.color));
+}
+
+void keyWarmer(uint8_t, uint8_t step) {
+    // warmer white, brightness is kept
+    if (state.color.mix + step < 255) state.color.mix += step; else state.color.mix = 255;
+    setPWM(colorPWM(state.color));
+}
+
+void keyNight(uint8_t, uint8_t) {
+    // Nightlight
+    state.night = !state.night;
+    if (state.night) {
+        fadeTo(setBrightness(NIGHT_BRIGHTNESS, NIGHT_MIX));
+    } else {
+        fadeTo(colorPWM(state.color));
     }
 }
 
-struct PWMdata readColor() {
-    struct PWMdata color;
-    color.coldWhite = EEPROM.read(EEPROM_COLD_WHITE_ADDR);
-    color.warmWhite = EEPROM.read(EEPROM_WARM_WHITE_ADDR);
-    return color;
+void keyLevel(uint8_t brightness, uint8_t) {
+    // fixed brightness: the keymap holds the CIE1931 lightness of 10%, 50% and 100% duty cycle,
+    // the output of these keys before the gamma correction (like NIGHT_BRIGHTNESS)
+    state.color.brightness = brightness;
+    fadeTo(colorPWM(state.color));
+}
+
+void keyStore(uint8_t, uint8_t) {
+    // D1: Store current color temperatur
+    storeState();
+    startBlink(1);
 }
 
-uint8_t getBrightness(struct PWMdata color) {    
-    if (color.coldWhite > whiteColor.warmWhite) {
-        return color.coldWhite;
+void keyTimer(uint8_t, uint8_t) {
+    // Night, 30min: sunrise, the nightlight ramps up to the saved color in the background
+    if (lastHandler == keyNight && state.night && !secondsPassed(lastKeyTime, SUNRISE_KEY_S)) {
+        state.night = false;
+        state.off = false;
+        state.timerStep = 0;
+        fadePWM(setBrightness(SUNRISE_BRIGHTNESS, NIGHT_MIX), colorPWM(state.color), SUNRISE_MS);
+        return;
+    }
+    // lights-off timer: 15, 30, 60, 90 min, off
+    state.timerStep = (state.timerStep + 1) % (LIGHTOFF_STEPS + 1);
+    lightOffTimer = seconds();
+    if (state.timerStep) {
+        startBlink(state.timerStep);    // one blink per step
     } else {
-        return color.warmWhite;
+        startBlink(1, 800);             // one long blink for off
     }
 }
 
-// Startup function
-void setup() {
+void startBlink(uint8_t count, uint16_t darkMs) {
+    blink.count = count;
+    blink.darkMs = darkMs;
+    blink.start = msTicks();
+    blinkDark = true;
+}
+
+void updateBlink() {
+    if (!blink.count) return;
+    if (!msPassed(blink.start, blinkDark ? blink.darkMs : BLINK_LIT_MS)) return;
+    blink.start = msTicks();
+    if (blinkDark) blink.count--;
+    blinkDark = blink.count && !blinkDark;
+}
+
+void storeState() {
+    logRecord.seq = logValid ? logRecord.seq + 1 : 0;
+    logRecord.state = packState();
+    logRecord.check = logChecksum(&logRecord);
+    logValid = true;
+
+    // write to the slot after the newest one, so every store hits other cells
+    logSlot = (logSlot + 1) % EEPROM_LOG_SLOTS;
+    const uint8_t *data = (const uint8_t *)&logRecord;
+    for (uint8_t i = 0; i < sizeof(logRecord); i++) {
+        eepromWrite(EEPROM_LOG_ADDR + logSlot * sizeof(logRecord) + i, data[i]);
+    }
+}
+
+void loadPresets() {
+    // user presets if the block is intact, the defaults from flash otherwise
+    for (uint8_t i = 0; i < PRESET_COUNT; i++) {
+        presets[i] = EEPROM.read(EEPROM_PRESET_ADDR + i);
+    }
+    if (EEPROM.read(EEPROM_PRESET_ADDR + PRESET_COUNT) == presetChecksum()) return;
+    for (uint8_t i = 0; i < PRESET_COUNT; i++) {
+        presets[i] = pgm_read_byte(&presetDefaults[i]);
+    }
+}
+
+void savePreset() {
+    presets[state.preset] = state.color.mix;
+    // unchanged bytes are skipped, so a save costs the preset byte and the CRC
+    for (uint8_t i = 0; i < PRESET_COUNT; i++) {
+        eepromWrite(EEPROM_PRESET_ADDR + i, presets[i]);
+    }
+    eepromWrite(EEPROM_PRESET_ADDR + PRESET_COUNT, presetChecksum());
+}
+
+uint8_t presetChecksum() {
+    // CRC8 of the preset block
+    return crc8(PRESET_SEED, presets, PRESET_COUNT);
+}
+
+void loadCalibration() {
+    // the block is only ever written with the EEPROM image (sim/calibration.py), the firmware just reads it
+    struct Calibration calibration;
+    uint8_t *data = (uint8_t *)&calibration;
+    for (uint8_t i = 0; i < sizeof(calibration); i++) {
+        data[i] = EEPROM.read(EEPROM_CALIBRATION_ADDR + i);
+    }
+    if (EEPROM.read(EEPROM_CALIBRATION_ADDR + sizeof(calibration)) != crc8(CALIBRATION_SEED, data, sizeof(calibration))) {
+        memcpy_P(&calibration, &calibrationDefaults, sizeof(calibration));
+    }
+    prepareChannel(&calCold, calibration.gainCold, calibration.maxCold);
+    prepareChannel(&calWarm, calibration.gainWarm, calibration.maxWarm);
+    powerBudget = calibration.budget << 8;
+#ifdef POWER_FAIL_SAVE
+    // 10 bit reading of the bandgap against Vcc, it rises as the supply falls; 17 counts between
+    // the thresholds, the trim takes the part's bandgap error out of them
+    uint16_t bandgapMv = 1100 + calibration.bandgapTrim;
+    vccFail = uint32_t(bandgapMv) * 1024 / VCC_FAIL_MV;
+    vccRecover = uint32_t(bandgapMv) * 1024 / VCC_RECOVER_MV;
+#endif
+}
+
+void prepareChannel(struct ChannelCalibration *channel, uint8_t gain, uint8_t max) {
+    channel->gain = gain;
+    channel->limit = max << 8;
+    // above maxLevel the duty cycle is flat at the limit, clamping the level instead keeps
+    // it convex for the power cap
+    channel->maxLevel = 255;
+    while (channel->maxLevel && scaleDuty(pgm_read_word(&gammaTable[channel->maxLevel]), gain) > channel->limit) {
+        channel->maxLevel--;
+    }
+}
+
+void schedulePersist() {
+    // (re)start the debounce, a burst of commands ends up in a single record
+    persist_pending = true;
+    persistTimer = seconds();
+}
+
+void persistState() {
+#ifdef PROFILE
+    // worst case durations go with the settings, unchanged bytes cost no write cycle
+    struct ProfileStats stats;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats = profileStats;
+    }
+    for (uint8_t i = 0; i < sizeof(stats); i++) {
+        eepromWrite(EEPROM_PROFILE_ADDR + i, ((const uint8_t *)&stats)[i]);
+    }
+#endif
+    persistRecord();
+}
+
+void persistRecord() {
+    persist_pending = false;
+    // nothing to write if the newest record already holds this state
+    if (logValid && stateEqual(logRecord.state, packState())) {
+        return;
+    }
+    storeState();
+}
+
+void scanLog() {
+    // records are written in slot order with consecutive sequence numbers: the newest one
+    // is the last record before the sequence breaks, torn or erased slots are skipped
+    struct LogRecord record;
+    uint8_t lastSeq = 0;
+    logValid = false;
+    logSlot = EEPROM_LOG_SLOTS - 1;
+    for (uint8_t slot = 0; slot < EEPROM_LOG_SLOTS; slot++) {
+        if (!readLogRecord(slot, &record)) continue;
+        if (logValid && record.seq != uint8_t(lastSeq + 1)) break;
+        lastSeq = record.seq;
+        logSlot = slot;
+        logRecord = record;
+        logValid = true;
+    }
+}
 
-    if (MCUSR & _BV(WDRF)){            // If a reset was caused by the Watchdog Timer...
-        MCUSR &= ~_BV(WDRF);                 // Clear the WDT reset flag
-        WDTCR |= (_BV(WDCE) | _BV(WDE));   // Enable the WD Change Bit
-        WDTCR = 0x00;                      // Disable the WDT
+bool readLogRecord(uint8_t slot, struct LogRecord *record) {
+    uint8_t *data = (uint8_t *)record;
+    for (uint8_t i = 0; i < sizeof(*record); i++) {
+        data[i] = EEPROM.read(EEPROM_LOG_ADDR + slot * sizeof(*record) + i);
     }
-    cli(); // with global interrupts disabled,
-    // Set up Watch Dog Timer for Inactivity
-    WDTCR |= (_BV(WDCE) | _BV(WDE));   // Enable the WD Change Bit
-    WDTCR =   _BV(WDIE) |              // Enable WDT Interrupt
-    _BV(WDP2) | _BV(WDP1);   // Set Timeout to ~1 seconds (or something)
-    sei(); // now re-enable global interrupts
+    return record->check == logChecksum(record);
+}
+
+uint8_t logChecksum(const struct LogRecord *record) {
+    // CRC8 over everything but the check byte
+    return crc8(LOG_SEED, record, sizeof(*record) - 1);
+}
 
-    restartDetectTimer = 0;
-    delay(10);
+void eepromWrite(uint16_t addr, uint8_t data) {
+    uint8_t next = (eepromHead + 1) & (EEPROM_QUEUE_SIZE - 1);
+    // queue full: wait for the ISR to take the next byte
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (next == eepromTail) {
+        sleep_mode();
+    }
+    eepromQueue[eepromHead].addr = addr;
+    eepromQueue[eepromHead].data = data;
+    eepromHead = next;
+    // EE_RDY is level triggered, it fires as soon as the EEPROM is idle
+    EECR |= (1 << EERIE);
+}
+
+bool eepromBusy() {
+    // bytes left in the queue or a write still programming
+    return (eepromHead != eepromTail) || (EECR & (1 << EEPE));
+}
+
+void eepromFlush() {
+    // wait until all queued bytes are programmed, e.g. before sleep or power loss
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (eepromBusy()) {
+        sleep_mode();
+    }
+}
+
+bool standbyAllowed() {
+    // lamp dark, nothing in progress and no IR frame being received
+    if (fadeActive() || blink.count || eepromBusy() || irHead != irTail) return false;
+    if (output.coldWhite > 1 || output.warmWhite > 1) return false;
+    return msPassed(irWakeTime, IR_WAKE_MS);
+}
+
+void enterStandby() {
+    // stop Timer1 (and the PLL), disconnect the PWM outputs and drive them low
+    suspendCalibration();
+    TCCR1 = 0;
+    GTCCR = 0;
+    PLLCSR = 0;
+    PORTB &= ~((1 << PB1) | (1 << PB4));
+    uint8_t adcsra = ADCSRA;
+    ADCSRA &= ~(1 << ADEN);
+
+    // wake up on the first edge of an NEC leader on PB2, the WDT keeps waking up every second
+    irWakeup = false;
+    GIFR = (1 << PCIF);
+    PCMSK |= (1 << PCINT2);
+    GIMSK |= (1 << PCIE);
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_mode();
+#ifndef IR_EDGE_DECODER
+    GIMSK &= ~(1 << PCIE);     // the edge decoder keeps using it
+#endif
+
+    ADCSRA = adcsra;
+    setupPWM();
+    // Timer0 and IRMP continue where they stopped, give them time for the frame
+    if (irWakeup) irWakeTime = msTicks();
+}
+
+#ifdef POWER_FAIL_SAVE
+void setupPowerMonitor() {
+    // bandgap against Vcc, free running at CK/128 (~4.8 kHz), interrupt on every result
+    ADMUX = (1 << MUX3) | (1 << MUX2);
+    ADCSRB = 0;
+    ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE) |
+             (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+void powerFailSave() {
+    // the outputs are already off (ADC ISR), commit the pending record while the capacitor lasts;
+    // just the record, no profile stats: at 3.4 ms per byte every byte counts
+    if (persist_pending) persistRecord();
+    eepromFlush();
+
+    // still alive: wait for the supply to come back after a short dip
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (ADC > vccRecover) {
+        sleep_mode();
+    }
+    powerFail = false;
+    TCCR1 |= (1 << COM1A1);
+    GTCCR |= (1 << COM1B1);
+    ADCSRA |= (1 << ADIE);
+}
+#else
+void setupPowerMonitor() {}
+#endif
+
+// Startup function
+void setup() {
+    // light first: PWM outputs and the saved color, the fade-in runs in the Timer1 interrupt
     pinMode(PB1, OUTPUT);
     pinMode(PB4, OUTPUT);
     digitalWrite(PB1, LOW);
     digitalWrite(PB4, LOW);
-    irmp_init();
     setupPWM();
- 
+
     // load saved settings from EEPROM
-    whiteColor = readColor();
-    brightness = getBrightness(whiteColor);
+    scanLog();
+    loadPresets();
+    loadCalibration();
+    if (logValid) unpackState(logRecord.state);
+    if (state.preset >= PRESET_COUNT) state.preset = 0;
+    // a power cycle always switches the lamp on, the saved nightlight mode is kept; records
+    // from before the lower limit of the darker key may still hold an unlit level
+    if (state.color.brightness < MIN_BRIGHTNESS) state.color.brightness = MIN_BRIGHTNESS;
 
-    if (resetMarker == MAGIC_VALUE) { // check for double tap
-        resetMarker = 0;
-        fadePWM((PWMdata){0,0}, setBrightness(5, (PWMdata){presets[4][0], presets[4][1]})); // set night light
+    // multi-tap: the marker of the previous power-on is still valid, decided right away
+    uint8_t taps = 1;
+    if (markerValid(&resetMarker) && resetMarker.taps >= 1 && resetMarker.taps <= TAP_COUNT) {
+        taps = resetMarker.taps < TAP_COUNT ? resetMarker.taps + 1 : TAP_COUNT;
+    }
+    markTaps(&resetMarker, taps);
+    switch (pgm_read_byte(&tapModes[taps - 1])) {
+        case TAP_NIGHT:
+            state.night = true;
+            break;
+        case TAP_FULL_COLD:
+            state.night = false;
+            state.color = (ColorState){255, 0};
+            break;
+    }
+    if (state.night) {
+        fadePWM((PWMdata){0,0}, setBrightness(NIGHT_BRIGHTNESS, NIGHT_MIX), 800, FADE_EASE_OUT); // set night light
     } else {
-        resetMarker = MAGIC_VALUE;
-        fadePWM((PWMdata){0,0}, whiteColor); // set EEPROM color
+        fadePWM((PWMdata){0,0}, colorPWM(state.color), 800, FADE_EASE_OUT); // set EEPROM color
     }
+
+    // everything else while the light fades in; after a WDT reset the watchdog runs with
+    // its 16 ms reset timeout until setupWDT(), the steps above take ~1 ms
+    setupWDT();
+    setupPowerMonitor();
+    setupProfile();
+    irmp_init();
+    irmp_register_complete_callback_function(&handleIRData);
 }
 
 
 // Main loop
 void loop() {
-    if (timeCounter > RESET_TIMEOUT_S) {
-        resetMarker = 0;
-    }
-    if (timer_start) {
-        if (timeCounter - lightOffTimer > LIGHTOFF_TIMEOUT_S) {
-            timer_start = false;
-            fadePWM(whiteColor, (PWMdata){0,0}); // set no color
-            is_on=false;
+    if (!markerCleared && secondsPassed(0, RESET_TIMEOUT_S + 1)) {
+        clearMarker(&resetMarker);
+        markerCleared = true;
+    }
+    if (state.timerStep) {
+        if (secondsPassed(lightOffTimer, uint32_t(lightOffMinutes[state.timerStep - 1]) * 60)) {
+            state.timerStep = 0;
+            fadeTo((PWMdata){0,0}, LIGHTOFF_FADE_MS); // dim down slowly in the background
+            state.off = true;
+            schedulePersist();
         }    
     } else {
-        lightOffTimer=timeCounter;
-    }
-    if (irmp_get_data(&irmp_data)) {
-        if (irmp_data.protocol != IRMP_ONKYO_PROTOCOL) {
-            if (irmp_data.protocol == IRMP_NEC_PROTOCOL && irmp_data.address == 0x00) { 
-                if ((irmp_data.flags == 0) || 
-                    (irmp_data.command ==  7 ||
-                     irmp_data.command ==  9 ||
-                     irmp_data.command == 25 ||
-                     irmp_data.command == 64
-                    )
-                   ) {
-                    processNECCommand(irmp_data.command);
-                }
-            }
+        lightOffTimer=seconds();
+    }
+#ifdef POWER_FAIL_SAVE
+    if (powerFail) powerFailSave();
+#endif
+    if (persist_pending && secondsPassed(persistTimer, PERSIST_DELAY_S)) {
+        persistState();
+    }
+    updateBlink();
+    struct IREvent event;
+    if (getIREvent(&event)) {
+        processKey(event.key, event.step);
+        schedulePersist();
+    }
+    bool standby = standbyAllowed();
+#ifdef POWER_FAIL_SAVE
+    // the ADC is off in standby, nothing would save the state on a power loss: save first,
+    // standby follows once the EEPROM is done
+    if (standby && persist_pending) {
+        persistState();
+        standby = false;
+    }
+#endif
+    if (standby) {
+        enterStandby();
+    } else if (irHead == irTail) {
+        // nothing queued: idle until the next interrupt, Timer1 wakes the CPU once per period
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        sleep_mode();
+    }
+}
+
+// IRMP callback, runs in the Timer0 (or pin change) interrupt when a frame is complete
+void handleIRData() {
+    PROFILE_SCOPE(PROFILE_IR);
+    if (!irmp_get_data(&irmp_data)) return;
+    if (irmp_data.protocol != IRMP_NEC_PROTOCOL) return;
+
+    uint8_t key = findKey(irmp_data.address, irmp_data.command);
+    if (key == KEY_NONE) return;
+    bool repeatable = pgm_read_byte(&keymap[key].flags) & KEY_REPEAT;
+    if (irmp_data.flags != 0 && !repeatable) return;
+
+    // key-hold acceleration: the step grows with every repeat frame, a new press starts over
+    if (irmp_data.flags & IRMP_FLAG_REPETITION) {
+        if (irHold < KEY_HOLD_MAX) irHold++;
+    } else {
+        irHold = 0;
+    }
+    uint8_t step = KEY_STEP + KEY_ACCEL * irHold;
+
+    if ((irmp_data.flags & IRMP_FLAG_REPETITION) && irHead != irTail) {
+        // key still held and its event not consumed yet: add the step instead of queueing a frame
+        uint8_t last = (irHead - 1) & (IR_QUEUE_SIZE - 1);
+        if (irQueue[last].key == key) {
+            if (irQueue[last].step < 255 - step) irQueue[last].step += step; else irQueue[last].step = 255;
+            return;
         }
     }
+
+    uint8_t next = (irHead + 1) & (IR_QUEUE_SIZE - 1);
+    if (next == irTail) return; // queue full, drop the frame
+    irQueue[irHead].key = key;
+    irQueue[irHead].step = step;
+    irHead = next;
+}
+
+bool getIREvent(struct IREvent *event) {
+    bool found = false;
+    // the callback may still merge repeats into this event, so copy and release it in one go
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (irTail != irHead) {
+            event->key = irQueue[irTail].key;
+            event->step = irQueue[irTail].step;
+            irTail = (irTail + 1) & (IR_QUEUE_SIZE - 1);
+            found = true;
+        }
+    }
+    return found;
+}
+
+// ISR for the IR pin change: wake up from standby, and the input of the edge decoder
+ISR(PCINT0_vect) {
+    irWakeup = true;
+#ifdef IR_EDGE_DECODER
+    necEdge();
+#endif
+}
+
+#ifdef POWER_FAIL_SAVE
+// ISR for the ADC: supply monitor, cuts the LED load as soon as Vcc drops
+ISR(ADC_vect) {
+    if (ADC < vccFail) {
+        vccLow = 0;
+        return;
+    }
+    if (++vccLow < VCC_FAIL_SAMPLES) return;
+    // disconnect OC1A/OC1B, the pins fall back to PORTB (low); Timer1 keeps the millisecond tick
+    TCCR1 &= ~(1 << COM1A1);
+    GTCCR &= ~(1 << COM1B1);
+    ADCSRA &= ~(1 << ADIE);
+    vccLow = 0;
+    powerFail = true;
 }
+#endif
+
+// ISR for the EEPROM ready interrupt: start the next queued byte write
+ISR(EE_RDY_vect) {
+    while (eepromTail != eepromHead) {
+        uint16_t addr = eepromQueue[eepromTail].addr;
+        uint8_t data = eepromQueue[eepromTail].data;
+        eepromTail = (eepromTail + 1) & (EEPROM_QUEUE_SIZE - 1);
 
-// ISR für den Watchdog-Timer
-ISR(WDT_vect) {
-    timeCounter++; // Sekunden-Zähler erhöhen
+        // like EEPROM.update(): unchanged bytes cost no write cycle
+        EEAR = addr;
+        EECR |= (1 << EERE);
+        if (EEDR == data) continue;
+
+        EEDR = data;
+        EECR = (1 << EERIE) | (1 << EEMPE);  // erase and write, EEPE has to follow within 4 cycles
+        EECR |= (1 << EEPE);
+        return;
+    }
+    // queue empty
+    EECR &= ~(1 << EERIE);
+}
+
+// ISR for Timer1 overflow: dithering, millisecond tick and background fade
+ISR(TIMER1_OVF_vect) {
+    profileOverflow();
+    if (PWM_OVF_DIVIDER > 1) {
+        if (--overflowCount) return;
+        overflowCount = PWM_OVF_DIVIDER;
+    }
+    PROFILE_SCOPE(PROFILE_TIMER1);
+
+    // duty cycles for the next PWM period (Duty cycle for PB1 / PB4), dark during a blink
+    if (blinkDark) {
+        OCR1A = 0;
+        OCR1B = 0;
+    } else {
+        OCR1A = ditherDuty(dutyCold, &ditherCold);
+        OCR1B = ditherDuty(dutyWarm, &ditherWarm);
+    }
+
+    // millisecond tick, the fade advances once per millisecond
+    if (!timebaseTick(PWM_TICK_HZ)) return;
+
+    if (!fade.active) return;
+    // at 31 and 62 kHz the fade step takes longer than PWM_OVF_DIVIDER periods: let the next
+    // overflows in, they count down and dither, the next fade step is a millisecond away
+    if (PWM_OVF_DIVIDER > 1) sei();
+    fade.phase += fade.phaseStep;
+    if (fade.phase >= FADE_PHASE_END) {
+        // end exactly on the stop color
+        fade.active = false;
+        writePWM((PWMdata){fade.target.coldWhite, fade.target.warmWhite});
+        return;
+    }
+    uint8_t eased = fadeEase(fade.curve, fade.phase);
+    writePWM((PWMdata){
+        fadeChannel(fade.start.coldWhite, fade.target.coldWhite, eased),
+        fadeChannel(fade.start.warmWhite, fade.target.warmWhite, eased)
+    });
 }
 
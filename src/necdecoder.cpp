@@ -0,0 +1,134 @@
+/*
+ * NEC-only IR decoder, see necdecoder.h.
+ */
+
+#ifdef IR_EDGE_DECODER
+
+#include <Arduino.h>
+#include <avr/io.h>
+#include "necdecoder.h"
+
+// Timer0 ticks at CK/1024 (128 us at 8 MHz)
+constexpr uint16_t necTicks(uint32_t us) {
+    return uint16_t(us * (F_CPU / 1024) / 1000000UL);
+}
+
+// falling edge to falling edge, with ~10% tolerance
+const uint16_t NEC_LEADER_MIN = necTicks(12500);    // 9 ms mark + 4.5 ms space
+const uint16_t NEC_LEADER_MAX = necTicks(14500);
+const uint16_t NEC_REPEAT_MIN = necTicks(10250);    // 9 ms mark + 2.25 ms space
+const uint16_t NEC_REPEAT_MAX = necTicks(12250);
+const uint16_t NEC_ONE_MIN = necTicks(1800);        // 560 us mark + 1690 us space
+const uint16_t NEC_ONE_MAX = necTicks(2700);
+const uint16_t NEC_ZERO_MIN = necTicks(800);        // 560 us mark + 560 us space
+const uint16_t NEC_ZERO_MAX = necTicks(1450);
+const uint16_t NEC_REPEAT_GAP = necTicks(120000);   // longest gap between a frame and its repeat
+const uint8_t NEC_IDLE = 0xFF;                      // necBitCount: waiting for a leader
+
+volatile uint8_t necOverflows = 0;  // high byte of the edge timestamps, Timer0 compare ISR
+uint16_t necLastEdge = 0;           // timestamp of the previous falling edge
+uint32_t necBits = 0;               // received bits, LSB first
+uint8_t necBitCount = NEC_IDLE;     // bits of the current frame, 32 = frame complete
+bool necRepeatable = false;         // a frame was received, repeats are accepted
+
+IRMP_DATA necData;
+volatile bool necAvailable = false;
+void (*necCallback)(void) = 0;
+
+void irmp_init() {
+    // Timer0 free running at CK/1024, the compare match counts the overflows
+    TCCR0A = 0;
+    TCCR0B = (1 << CS02) | (1 << CS00);
+    OCR0A = 0;
+    TIMSK |= (1 << OCIE0A);
+    // pin change interrupt on the receiver output
+    DDRB &= ~(1 << PB2);
+    PCMSK |= (1 << PCINT2);
+    GIFR = (1 << PCIF);
+    GIMSK |= (1 << PCIE);
+}
+
+bool irmp_get_data(IRMP_DATA *data) {
+    if (!necAvailable) return false;
+    data->protocol = necData.protocol;
+    data->address = necData.address;
+    data->command = necData.command;
+    data->flags = necData.flags;
+    necAvailable = false;
+    return true;
+}
+
+void irmp_register_complete_callback_function(void (*callback)(void)) {
+    necCallback = callback;
+}
+
+static void necDeliver(uint8_t flags) {
+    necData.flags = flags;
+    necAvailable = true;
+    if (necCallback) necCallback();
+}
+
+static void necFrame() {
+    uint8_t address = necBits;
+    uint8_t addressInverted = necBits >> 8;
+    uint8_t command = necBits >> 16;
+    uint8_t commandInverted = necBits >> 24;
+    necRepeatable = false;
+    if (uint8_t(command ^ commandInverted) != 0xFF) return;
+
+    necData.protocol = IRMP_NEC_PROTOCOL;
+    if (uint8_t(address ^ addressInverted) == 0xFF) {
+        necData.address = address;
+    } else {
+        necData.address = (uint16_t(addressInverted) << 8) | address;
+    }
+    necData.command = command;
+    necRepeatable = true;
+    necDeliver(0);
+}
+
+// called from the PCINT0 interrupt on every pin change
+void necEdge() {
+    // receiver output is active low, only the start of a mark counts
+    if (PINB & (1 << PB2)) return;
+
+    uint8_t count = TCNT0;
+    uint8_t high = necOverflows;
+    // an overflow not yet counted by the compare ISR (interrupts are off)
+    if ((TIFR & (1 << OCF0A)) && count < 128) high++;
+    uint16_t now = (uint16_t(high) << 8) | count;
+    uint16_t interval = now - necLastEdge;
+    necLastEdge = now;
+
+    if (interval >= NEC_LEADER_MIN && interval <= NEC_LEADER_MAX) {
+        necBitCount = 0;
+        necBits = 0;
+        return;
+    }
+    if (necBitCount < 32) {
+        if (interval >= NEC_ZERO_MIN && interval <= NEC_ZERO_MAX) {
+            necBits >>= 1;
+        } else if (interval >= NEC_ONE_MIN && interval <= NEC_ONE_MAX) {
+            necBits = (necBits >> 1) | 0x80000000UL;
+        } else {
+            // broken frame, wait for the next leader
+            necBitCount = NEC_IDLE;
+            necRepeatable = false;
+            return;
+        }
+        if (++necBitCount == 32) necFrame();
+        return;
+    }
+    if (interval >= NEC_REPEAT_MIN && interval <= NEC_REPEAT_MAX) {
+        if (necRepeatable) necDeliver(IRMP_FLAG_REPETITION);
+        return;
+    }
+    // the gap in front of a repeat is shorter, a longer one ends the key press
+    if (interval > NEC_REPEAT_GAP) necRepeatable = false;
+}
+
+ISR(TIMER0_COMPA_vect) {
+    necOverflows++;
+}
+
+#endif
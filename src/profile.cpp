@@ -0,0 +1,32 @@
+/*
+ * Profiling of the hot paths, see profile.h.
+ */
+
+#ifdef PROFILE
+
+#include <Arduino.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "profile.h"
+
+struct ProfileStats profileStats;
+volatile uint32_t profileOverflows = 0;
+
+void setupProfile() {
+    PORTB &= ~((1 << PB0) | (1 << PB3));
+    DDRB |= (1 << PB0) | (1 << PB3);
+}
+
+uint32_t profileTime() {
+    uint32_t overflows;
+    uint8_t count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        overflows = profileOverflows;
+        count = TCNT1;
+        // an overflow not yet counted by the ISR (interrupts are off)
+        if ((TIFR & (1 << TOV1)) && count < 128) overflows++;
+    }
+    return (overflows << 8) | count;
+}
+
+#endif
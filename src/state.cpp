@@ -0,0 +1,57 @@
+/*
+ * Controller state, see state.h.
+ */
+
+#include <string.h>
+#include <util/crc16.h>
+#include "state.h"
+
+const uint8_t MARKER_SEED = 0xAB;       // CRC start value of the reset marker, cleared RAM doesn't pass
+
+struct ControllerState state = {{128, 128}, 0, 0, 0, 0};
+
+uint8_t crc8(uint8_t crc, const void *data, uint8_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (uint8_t i = 0; i < size; i++) {
+        crc = _crc8_ccitt_update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+struct ControllerState packState() {
+    // the lights-off timer doesn't survive a power cycle and a power cycle always switches the
+    // lamp on, so neither is part of the image
+    struct ControllerState image = state;
+    image.timerStep = 0;
+    image.off = 0;
+    return image;
+}
+
+void unpackState(struct ControllerState image) {
+    state = image;
+    state.timerStep = 0;
+    state.off = 0;
+}
+
+bool stateEqual(struct ControllerState a, struct ControllerState b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+void markTaps(volatile struct ResetMarker *marker, uint8_t taps) {
+    struct ResetMarker image;
+    image.taps = taps;
+    image.check = crc8(MARKER_SEED, &image, sizeof(image) - 1);
+    memcpy((void *)marker, &image, sizeof(image));
+}
+
+bool markerValid(const volatile struct ResetMarker *marker) {
+    struct ResetMarker image;
+    memcpy(&image, (const void *)marker, sizeof(image));
+    return image.check == crc8(MARKER_SEED, &image, sizeof(image) - 1);
+}
+
+void clearMarker(volatile struct ResetMarker *marker) {
+    struct ResetMarker image;
+    memcpy(&image, (const void *)marker, sizeof(image));
+    marker->check = crc8(MARKER_SEED, &image, sizeof(image) - 1) ^ 0xFF;
+}
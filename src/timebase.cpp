@@ -0,0 +1,76 @@
+/*
+ * Timebase for the LED Lighting Controller, see timebase.h.
+ */
+
+#include <Arduino.h>
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include "timebase.h"
+
+volatile uint32_t timeCounter = 0;
+volatile uint16_t msCounter = 0;
+uint16_t msFraction = 0;
+
+const uint16_t WDT_NOMINAL = 1000 * 16;        // nominal WDT period in 1/16 ms
+const uint16_t WDT_MIN_MS = 700;               // plausible range of a measured period
+const uint16_t WDT_MAX_MS = 1300;
+
+uint16_t wdtPeriod = WDT_NOMINAL;              // filtered WDT period in 1/16 ms
+uint16_t wdtAccum = 0;                         // time not yet counted as a second, 1/16 ms
+uint16_t wdtLastMs = 0;                        // msCounter at the previous WDT interrupt
+volatile bool wdtMeasure = false;              // the millisecond tick ran through the whole period
+
+void setupWDT() {
+    if (MCUSR & _BV(WDRF)){            // If a reset was caused by the Watchdog Timer...
+        MCUSR &= ~_BV(WDRF);                 // Clear the WDT reset flag
+        WDTCR |= (_BV(WDCE) | _BV(WDE));   // Enable the WD Change Bit
+        WDTCR = 0x00;                      // Disable the WDT
+    }
+    cli(); // with global interrupts disabled,
+    // Set up Watch Dog Timer for Inactivity
+    WDTCR |= (_BV(WDCE) | _BV(WDE));   // Enable the WD Change Bit
+    WDTCR =   _BV(WDIE) |              // Enable WDT Interrupt
+    _BV(WDP2) | _BV(WDP1);   // Set Timeout to ~1 seconds (or something)
+    sei(); // now re-enable global interrupts
+}
+
+void suspendCalibration() {
+    // Timer1 is about to stop, the current WDT period can't be measured
+    wdtMeasure = false;
+}
+
+uint32_t seconds() {
+    uint32_t time;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        time = timeCounter;
+    }
+    return time;
+}
+
+uint16_t msTicks() {
+    uint16_t ticks;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ticks = msCounter;
+    }
+    return ticks;
+}
+
+// ISR für den Watchdog-Timer
+ISR(WDT_vect) {
+    // calibrate against the system clock, low pass 1/8 to smooth the +-1 ms tick jitter
+    uint16_t now = msCounter;
+    uint16_t measured = now - wdtLastMs;
+    if (wdtMeasure && measured >= WDT_MIN_MS && measured <= WDT_MAX_MS) {
+        wdtPeriod = wdtPeriod - (wdtPeriod >> 3) + (measured << 1);
+    }
+    wdtLastMs = now;
+    wdtMeasure = true;
+
+    // Sekunden-Zähler erhöhen, um die gemessene WDT-Periode
+    wdtAccum += wdtPeriod;
+    while (wdtAccum >= WDT_NOMINAL) {
+        wdtAccum -= WDT_NOMINAL;
+        timeCounter++;
+    }
+}
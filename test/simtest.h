@@ -0,0 +1,140 @@
+/*
+ * Helpers of the simulator regression tests: golden files, latency budgets and the NEC commands
+ * of the remote.
+ *
+ * Every test suite runs one scenario through the host simulation (see sim/simulator.h) and
+ * compares the PWM timeline and the EEPROM image with the golden files next to its test source.
+ * The timelines are duty cycle means over simConfig.sampleUs (4 ms, 8 PWM periods at CK/16);
+ * test_dither records single periods.
+ * After an intended change of the output, `SIM_GOLDEN_UPDATE=1 pio test -e native` rewrites them;
+ * review the diff before committing it.
+ */
+
+#ifndef SIMTEST_H
+#define SIMTEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include "simulator.h"
+
+// NEC commands of the Lidl remote, see doc/ir-codes
+enum Key : uint8_t {
+    KEY_POWER = 69, KEY_LAMP = 71, KEY_WARM = 64, KEY_COLD = 25,
+    KEY_LOW = 7, KEY_HIGH = 9, KEY_10 = 12, KEY_50 = 24, KEY_100 = 94,
+    KEY_NIGHT = 8, KEY_D1 = 28, KEY_30MIN = 90,
+};
+
+const int32_t RESPONSE_BUDGET_MS = 150;     // first output change after the frame, also when it wakes the CPU from standby
+
+// golden file `name` in the directory of the test source `file` (__FILE__)
+inline std::string goldenPath(const char *file, const char *name) {
+    std::string path(file);
+    size_t slash = path.find_last_of('/');
+    return (slash == std::string::npos ? std::string() : path.substr(0, slash + 1)) + name;
+}
+
+inline bool goldenUpdate() {
+    const char *update = getenv("SIM_GOLDEN_UPDATE");
+    return update && *update && strcmp(update, "0");
+}
+
+// compares `text` with the golden file line by line, or rewrites it in update mode
+inline void checkGolden(const std::string &path, const std::string &text) {
+    if (goldenUpdate()) {
+        FILE *file = fopen(path.c_str(), "w");
+        TEST_ASSERT_NOT_NULL_MESSAGE(file, path.c_str());
+        fputs(text.c_str(), file);
+        fclose(file);
+        return;
+    }
+    FILE *file = fopen(path.c_str(), "r");
+    TEST_ASSERT_NOT_NULL_MESSAGE(file, (path + ": missing, run with SIM_GOLDEN_UPDATE=1").c_str());
+    std::string golden;
+    char buffer[256];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) golden.append(buffer, length);
+    fclose(file);
+
+    unsigned line = 1;
+    size_t lineStart = 0;
+    size_t i = 0;
+    while (i < golden.size() && i < text.size() && golden[i] == text[i]) {
+        if (golden[i++] == '\n') {
+            line++;
+            lineStart = i;
+        }
+    }
+    if (i == golden.size() && i == text.size()) return;
+    std::string expected = golden.substr(lineStart, golden.find('\n', lineStart) - lineStart);
+    std::string actual = text.substr(lineStart, text.find('\n', lineStart) - lineStart);
+    char message[256];
+    snprintf(message, sizeof(message), "%s:%u: expected \"%s\", got \"%s\"",
+             path.c_str(), line, expected.c_str(), actual.c_str());
+    TEST_FAIL_MESSAGE(message);
+}
+
+// the PWM timeline as `time_ms cold warm` lines, the format of `replay -t`
+inline std::string timelineText() {
+    std::string text;
+    char line[64];
+    for (size_t i = 0; i < simTimeline().size(); i++) {
+        const SimSample &sample = simTimeline()[i];
+        snprintf(line, sizeof(line), "%u %.2f %.2f\n", sample.timeMs, sample.cold, sample.warm);
+        text += line;
+    }
+    return text;
+}
+
+// the EEPROM image as hex dump, 16 bytes per line
+inline std::string eepromText() {
+    std::string text;
+    char line[64];
+    const uint8_t *image = simEeprom();
+    for (unsigned addr = 0; addr < 512; addr += 16) {
+        int length = snprintf(line, sizeof(line), "%03x:", addr);
+        for (unsigned i = 0; i < 16; i++) {
+            length += snprintf(line + length, sizeof(line) - length, " %02x", image[addr + i]);
+        }
+        text += line;
+        text += '\n';
+    }
+    return text;
+}
+
+// every key was decoded and changed the output within the response budget
+inline void checkResponses() {
+    char message[64];
+    for (size_t i = 1; i < simCommands().size(); i++) {
+        const SimCommand &command = simCommands()[i];
+        snprintf(message, sizeof(message), "command %u at %u ms", command.command, command.timeMs);
+        TEST_ASSERT_EQUAL_UINT16_MESSAGE(0, command.lost, message);
+        TEST_ASSERT_GREATER_THAN_UINT16_MESSAGE(0, command.frames, message);
+        TEST_ASSERT_GREATER_OR_EQUAL_INT32_MESSAGE(0, command.responseMs, message);
+        TEST_ASSERT_LESS_OR_EQUAL_INT32_MESSAGE(RESPONSE_BUDGET_MS, command.responseMs, message);
+    }
+}
+
+// the output of the command at `timeMs` came to rest within `budgetMs`
+inline void checkSettle(uint32_t timeMs, int32_t budgetMs) {
+    for (size_t i = 1; i < simCommands().size(); i++) {
+        const SimCommand &command = simCommands()[i];
+        if (command.timeMs != timeMs) continue;
+        TEST_ASSERT_LESS_OR_EQUAL_INT32(budgetMs, command.settleMs);
+        return;
+    }
+    TEST_FAIL_MESSAGE("no command at this time");
+}
+
+// the last timeline sample before `timeMs`
+inline SimSample sampleAt(uint32_t timeMs) {
+    SimSample sample = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < simTimeline().size() && simTimeline()[i].timeMs <= timeMs; i++) {
+        sample = simTimeline()[i];
+    }
+    return sample;
+}
+
+#endif
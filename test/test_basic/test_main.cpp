@@ -0,0 +1,55 @@
+/*
+ * Everyday use: dim, change the color temperature, cycle a preset, save and switch off and on
+ * (sim/scripts/basic.ir).
+ */
+
+#include "../simtest.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_timeline() {
+    checkGolden(goldenPath(__FILE__, "timeline.golden"), timelineText());
+}
+
+void test_eeprom() {
+    checkGolden(goldenPath(__FILE__, "eeprom.golden"), eepromText());
+}
+
+void test_responses() {
+    checkResponses();
+}
+
+void test_fades() {
+    // held keys change the output while their frames repeat, the other keys fade or blink
+    checkSettle(1000, 300 + RESPONSE_BUDGET_MS);
+    checkSettle(3000, 500 + RESPONSE_BUDGET_MS);
+    checkSettle(5000, 800 + RESPONSE_BUDGET_MS);
+    checkSettle(7000, 200 + RESPONSE_BUDGET_MS);
+    checkSettle(9000, 800 + RESPONSE_BUDGET_MS);
+    checkSettle(15000, 800 + RESPONSE_BUDGET_MS);
+}
+
+void test_eeprom_writes() {
+    // D1 and the auto-saves, each record is 5 bytes
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(3 * 5, simEepromWrites());
+}
+
+int main() {
+    simPowerOn();
+    simKey(1000, KEY_LOW, 300);
+    simKey(3000, KEY_WARM, 500);
+    simKey(5000, KEY_LAMP);
+    simKey(7000, KEY_D1);
+    simKey(9000, KEY_POWER);
+    simKey(15000, KEY_POWER);
+    simRun(20000);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_timeline);
+    RUN_TEST(test_eeprom);
+    RUN_TEST(test_responses);
+    RUN_TEST(test_fades);
+    RUN_TEST(test_eeprom_writes);
+    return UNITY_END();
+}
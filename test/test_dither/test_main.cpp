@@ -0,0 +1,94 @@
+/*
+ * Per-period PWM output: the OCR1A/OCR1B values of every Timer1 period over two short windows,
+ * during the fade of the 10% key and once it has settled. The other suites compare means over
+ * 4 ms windows (simConfig.sampleUs), which hide the dither pattern.
+ */
+
+#include "../simtest.h"
+
+const uint32_t KEY_MS = 1000;
+const uint32_t FADE_FROM_MS = 1050;         // per-period window inside the 800 ms fade
+const uint32_t FADE_TO_MS = 1100;
+const uint32_t STEADY_FROM_MS = 2500;       // per-period window at the settled level
+const uint32_t STEADY_TO_MS = 2550;
+const uint32_t PERIOD_US = 512;             // CK/16, OCR1C = 255
+const uint8_t DITHER_PERIODS = 8;           // 2^DITHER_BITS
+
+void setUp() {}
+void tearDown() {}
+
+// samples of a per-period window as `time_us cold warm` lines, the OCR values as integers
+std::string periodText(uint32_t fromMs, uint32_t toMs) {
+    std::string text;
+    char line[64];
+    for (size_t i = 0; i < simTimeline().size(); i++) {
+        const SimSample &sample = simTimeline()[i];
+        if (sample.timeMs < fromMs || sample.timeMs >= toMs) continue;
+        snprintf(line, sizeof(line), "%u %.0f %.0f\n", sample.timeUs, sample.cold, sample.warm);
+        text += line;
+    }
+    return text;
+}
+
+// the per-period samples of a window, in order
+std::vector<SimSample> periods(uint32_t fromMs, uint32_t toMs) {
+    std::vector<SimSample> samples;
+    for (size_t i = 0; i < simTimeline().size(); i++) {
+        const SimSample &sample = simTimeline()[i];
+        if (sample.timeMs >= fromMs && sample.timeMs < toMs) samples.push_back(sample);
+    }
+    return samples;
+}
+
+void test_periods() {
+    checkGolden(goldenPath(__FILE__, "periods.golden"),
+                periodText(FADE_FROM_MS, FADE_TO_MS) + periodText(STEADY_FROM_MS, STEADY_TO_MS));
+}
+
+void test_every_period() {
+    // one sample per PWM period, none merged or missing
+    std::vector<SimSample> samples = periods(FADE_FROM_MS, FADE_TO_MS);
+    TEST_ASSERT_GREATER_THAN_UINT32(90, samples.size());
+    for (size_t i = 1; i < samples.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(PERIOD_US, samples[i].timeUs - samples[i - 1].timeUs);
+    }
+}
+
+void test_dither() {
+    // settled: every period is one of the two adjacent 8-bit duty cycles, and any 2^DITHER_BITS
+    // consecutive periods add up to the 8.8 level the averaged timeline shows
+    SimSample level = sampleAt(STEADY_FROM_MS - 100);
+    std::vector<SimSample> samples = periods(STEADY_FROM_MS, STEADY_TO_MS);
+    TEST_ASSERT_GREATER_THAN_UINT32(DITHER_PERIODS * 4, samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        TEST_ASSERT_TRUE(samples[i].cold == float(int(level.cold)) || samples[i].cold == float(int(level.cold) + 1));
+    }
+    for (size_t i = 0; i + DITHER_PERIODS <= samples.size(); i++) {
+        float cold = 0;
+        float warm = 0;
+        for (size_t j = i; j < i + DITHER_PERIODS; j++) {
+            cold += samples[j].cold;
+            warm += samples[j].warm;
+        }
+        TEST_ASSERT_EQUAL_FLOAT(level.cold, cold / DITHER_PERIODS);
+        TEST_ASSERT_EQUAL_FLOAT(level.warm, warm / DITHER_PERIODS);
+    }
+}
+
+int main() {
+    simPowerOn();
+    simKey(KEY_MS, KEY_10);
+    simRun(FADE_FROM_MS);
+    simConfig.sampleUs = 0;
+    simRun(FADE_TO_MS);
+    simConfig.sampleUs = 4096;
+    simRun(STEADY_FROM_MS);
+    simConfig.sampleUs = 0;
+    simRun(STEADY_TO_MS);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_periods);
+    RUN_TEST(test_every_period);
+    RUN_TEST(test_dither);
+    return UNITY_END();
+}
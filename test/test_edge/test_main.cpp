@@ -0,0 +1,47 @@
+/*
+ * The everyday use of test_basic through the pin change NEC decoder (-D IR_EDGE_DECODER, pio test
+ * -e native_edge): the simulation drives PB2 with the receiver output of every frame.
+ */
+
+#include "../simtest.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_timeline() {
+    checkGolden(goldenPath(__FILE__, "timeline.golden"), timelineText());
+}
+
+void test_eeprom() {
+    // the same keys store the same settings as with IRMP
+    checkGolden(goldenPath(__FILE__, "../test_basic/eeprom.golden"), eepromText());
+}
+
+void test_responses() {
+    checkResponses();
+    TEST_ASSERT_EQUAL_UINT32(0, simFramesLost());
+}
+
+void test_repeats() {
+    // held keys: the first frame and its repeat frames, 108 ms apart
+    TEST_ASSERT_EQUAL_UINT16(3, simCommands()[1].frames);
+    TEST_ASSERT_EQUAL_UINT16(5, simCommands()[2].frames);
+}
+
+int main() {
+    simPowerOn();
+    simKey(1000, KEY_LOW, 300);
+    simKey(3000, KEY_WARM, 500);
+    simKey(5000, KEY_LAMP);
+    simKey(7000, KEY_D1);
+    simKey(9000, KEY_POWER);
+    simKey(15000, KEY_POWER);
+    simRun(20000);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_timeline);
+    RUN_TEST(test_eeprom);
+    RUN_TEST(test_responses);
+    RUN_TEST(test_repeats);
+    return UNITY_END();
+}
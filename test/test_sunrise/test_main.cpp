@@ -0,0 +1,60 @@
+/*
+ * Sunrise: Night, then 30min ramps from the deepest warm level up to the saved color over 25 min
+ * in small steps (sim/scripts/sunrise.ir).
+ */
+
+#include "../simtest.h"
+
+const uint32_t NIGHT_MS = 1000;
+const uint32_t SUNRISE_MS = 3000;
+const uint32_t RAMP_MS = 25UL * 60 * 1000;
+
+void setUp() {}
+void tearDown() {}
+
+void test_timeline() {
+    checkGolden(goldenPath(__FILE__, "timeline.golden"), timelineText());
+}
+
+void test_responses() {
+    checkResponses();
+}
+
+void test_ramp() {
+    // ends on the color from before the nightlight on time: the rounded fade step takes 0.35 s
+    // off the 25 min, the key response adds less than RESPONSE_BUDGET_MS
+    SimSample saved = sampleAt(NIGHT_MS);
+    SimSample last = simTimeline().back();
+    TEST_ASSERT_EQUAL_FLOAT(saved.cold, last.cold);
+    TEST_ASSERT_EQUAL_FLOAT(saved.warm, last.warm);
+    TEST_ASSERT_UINT32_WITHIN(500, SUNRISE_MS + RAMP_MS, last.timeMs);
+}
+
+void test_steps() {
+    // always brighter, never by a visible jump
+    SimSample previous = sampleAt(SUNRISE_MS + 200);
+    TEST_ASSERT_TRUE(previous.warm < 0.5f);
+    char message[64];
+    for (size_t i = 0; i < simTimeline().size(); i++) {
+        const SimSample &sample = simTimeline()[i];
+        if (sample.timeMs <= previous.timeMs) continue;
+        snprintf(message, sizeof(message), "at %u ms", sample.timeMs);
+        TEST_ASSERT_TRUE_MESSAGE(sample.cold >= previous.cold && sample.warm >= previous.warm, message);
+        TEST_ASSERT_TRUE_MESSAGE(sample.cold - previous.cold <= 1.0f && sample.warm - previous.warm <= 1.0f, message);
+        previous = sample;
+    }
+}
+
+int main() {
+    simPowerOn();
+    simKey(NIGHT_MS, KEY_NIGHT);
+    simKey(SUNRISE_MS, KEY_30MIN);
+    simRun(SUNRISE_MS + RAMP_MS + 60000);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_timeline);
+    RUN_TEST(test_responses);
+    RUN_TEST(test_ramp);
+    RUN_TEST(test_steps);
+    return UNITY_END();
+}
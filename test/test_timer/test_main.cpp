@@ -0,0 +1,66 @@
+/*
+ * 15 min lights-off timer with a 10% slow WDT oscillator: the timer still expires on time, the
+ * lamp dims down over one minute and goes to standby (sim/scripts/timer.ir).
+ */
+
+#include "../simtest.h"
+
+const uint32_t KEY_MS = 1000;
+const uint32_t TIMER_MS = 15UL * 60 * 1000;
+const uint32_t FADE_MS = 60000;
+const uint32_t STANDBY_MS = 970000;             // the lamp is dark and in standby from here on
+
+void setUp() {}
+void tearDown() {}
+
+void test_timeline() {
+    checkGolden(goldenPath(__FILE__, "timeline.golden"), timelineText());
+}
+
+void test_eeprom() {
+    checkGolden(goldenPath(__FILE__, "eeprom.golden"), eepromText());
+}
+
+void test_responses() {
+    checkResponses();
+}
+
+void test_expiry() {
+    // the fade-out starts within a WDT period of the nominal time and takes one minute
+    SimSample lit = sampleAt(KEY_MS + 10000);
+    TEST_ASSERT_TRUE(lit.cold > 0);
+    uint32_t start = 0, dark = 0;
+    for (size_t i = 0; i < simTimeline().size(); i++) {
+        const SimSample &sample = simTimeline()[i];
+        if (sample.timeMs <= lit.timeMs) continue;
+        if (!start) start = sample.timeMs;
+        if (!dark && sample.cold == 0 && sample.warm == 0) dark = sample.timeMs;
+    }
+    TEST_ASSERT_UINT32_WITHIN(1500, KEY_MS + TIMER_MS, start);
+    TEST_ASSERT_UINT32_WITHIN(1500, KEY_MS + TIMER_MS + FADE_MS, dark);
+}
+
+uint32_t standbyLoops;
+
+void test_standby() {
+    // powered down after the fade-out, only the WDT wakes the CPU about once a second
+    TEST_ASSERT_LESS_THAN_UINT32((1000000 - STANDBY_MS) / 1000 * 2, standbyLoops);
+}
+
+int main() {
+    simConfig.wdtScale = 1.1f;
+    simPowerOn();
+    simKey(KEY_MS, KEY_30MIN);
+    simRun(STANDBY_MS);
+    uint32_t loops = simCommands().back().loops;
+    simRun(1000000);
+    standbyLoops = simCommands().back().loops - loops;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_timeline);
+    RUN_TEST(test_eeprom);
+    RUN_TEST(test_responses);
+    RUN_TEST(test_expiry);
+    RUN_TEST(test_standby);
+    return UNITY_END();
+}
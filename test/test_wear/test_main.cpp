@@ -0,0 +1,65 @@
+/*
+ * Wear leveling: 200 auto-saves go round the 96 slot settings log twice, every slot is used
+ * and the newest record holds the current state.
+ */
+
+#include "../simtest.h"
+#include "state.h"
+
+const uint8_t LOG_SLOTS = 96;
+const uint8_t RECORD_SIZE = 5;          // sequence number, state, CRC8
+const uint16_t SAVES = 200;
+const uint32_t SAVE_PERIOD_MS = 6000;   // one command per auto-save delay (5 s)
+
+void setUp() {}
+void tearDown() {}
+
+void test_eeprom() {
+    checkGolden(goldenPath(__FILE__, "eeprom.golden"), eepromText());
+}
+
+void test_responses() {
+    checkResponses();
+}
+
+void test_writes() {
+    // at most one record per command, unchanged bytes are skipped
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(SAVES * RECORD_SIZE, simEepromWrites());
+    TEST_ASSERT_GREATER_THAN_UINT32((SAVES - 1) * 2, simEepromWrites());
+}
+
+void test_ring() {
+    // consecutive sequence numbers in every slot, broken once after the newest record
+    const uint8_t *image = simEeprom();
+    uint8_t breaks = 0, newest = 0;
+    for (uint8_t slot = 0; slot < LOG_SLOTS; slot++) {
+        uint8_t next = (slot + 1) % LOG_SLOTS;
+        if (uint8_t(image[slot * RECORD_SIZE] + 1) != image[next * RECORD_SIZE]) {
+            breaks++;
+            newest = slot;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(1, breaks);
+    TEST_ASSERT_EQUAL_UINT8(SAVES - 1, image[newest * RECORD_SIZE]);
+    TEST_ASSERT_EQUAL_UINT8((SAVES - 1) % LOG_SLOTS, newest);
+
+    struct ControllerState saved;
+    memcpy(&saved, &image[newest * RECORD_SIZE + 1], sizeof(saved));
+    TEST_ASSERT_TRUE(stateEqual(saved, packState()));
+}
+
+int main() {
+    simPowerOn();
+    // alternating keys, so every save is a new state
+    for (uint16_t i = 0; i < SAVES; i++) {
+        simKey(1000 + i * SAVE_PERIOD_MS, i % 2 ? KEY_COLD : KEY_WARM);
+    }
+    simRun(1000 + SAVES * SAVE_PERIOD_MS);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_eeprom);
+    RUN_TEST(test_responses);
+    RUN_TEST(test_writes);
+    RUN_TEST(test_ring);
+    return UNITY_END();
+}